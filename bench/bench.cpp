@@ -0,0 +1,427 @@
+#include <iostream>
+#include <chrono>
+#include <cassert>
+#include <thread>
+#include <algorithm>
+#include "../scanner/Scanner.h"
+#include "../scanner/Preprocessor.h"
+#include "../util/FileReader.h"
+#include "../reporting/ErrorPrinter.h"
+#include "../interpreter/Interpreter.h"
+#include "../interpreter/InterpreterCalculator.h"
+#include "../interpreter/FunctionExtractor.h"
+#include "../compiler/BytecodeCompiler.h"
+#include "../compiler/Optimizer.h"
+
+// discards output, returns the same input for every read
+class BenchmarkIO : public IInterpreterIO{
+public:
+    BenchmarkIO(const Value& input, const Value& textInput): input(input), textInput(textInput){}
+
+    std::unique_ptr<Value> read() override { return std::make_unique<Value>(input); }
+
+    void write(const Value& value) override {}
+
+    std::unique_ptr<Value> readText() override { return std::make_unique<Value>(textInput); }
+
+    void writeText(const Value& value) override {}
+
+private:
+    Value input;
+    Value textInput;
+};
+
+ErrorPrinter errorPrinter;
+
+// returns the average execution time in milliseconds, instructions is set to the bytecode instructions per run
+double runScript(
+    const std::string& source,
+    const Value& input,
+    int repeats,
+    InterpreterEngine engine = InterpreterEngineBytecode,
+    unsigned long long* instructions = nullptr)
+{
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    BenchmarkIO io(input, {'a', ' ', 'b'});
+    Interpreter interpreter(&errorPrinter, &io, engine);
+    const auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<repeats; i++){
+        Value result;
+        assert(interpreter.execute(exec, functions, result));
+    }
+    const auto end = std::chrono::steady_clock::now();
+    if(instructions != nullptr)
+        *instructions = interpreter.getExecutedInstructions() / repeats;
+
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+void report(const std::string& name, double milliseconds)
+{
+    std::cout << name << ": " << milliseconds << " ms" << std::endl;
+}
+
+void benchmarkLoopWithIf()
+{
+    std::string source = 
+        "I = 0\n"
+        "S = 0\n"
+        "do I < 10000 {\n"
+        "    I = I + 1\n"
+        "    if I % 3 == 0 {\n"
+        "        S = S + I\n"
+        "    }\n"
+        "}\n"
+        "S\n";
+
+    report("10000 iteration loop with nested if", runScript(source, {0.0}, 10));
+}
+
+// dispatch cost per bytecode instruction, compared with the other engines
+void benchmarkDispatch(const std::string& filepath, const Value& input, int repeats)
+{
+    std::string source;
+    assert(FileReader::read(filepath, source));
+    assert(Preprocessor::process(source, source, filepath, &errorPrinter));
+
+    report(filepath + " tokens", runScript(source, input, repeats, InterpreterEngineTokens));
+    report(filepath + " syntax tree", runScript(source, input, repeats, InterpreterEngineSyntaxTree));
+
+    unsigned long long instructions;
+    const double milliseconds = runScript(source, input, repeats, InterpreterEngineBytecode, &instructions);
+    report(filepath + " bytecode", milliseconds);
+    std::cout << filepath << " bytecode: " << instructions << " instructions, "
+        << milliseconds * 1e6 / instructions << " ns per instruction" << std::endl;
+}
+
+// every mention of a large variable reads the whole array
+void benchmarkLargeVariableReads()
+{
+    std::string source = 
+        "A = 1000000 i + 0.5\n"
+        "I = 0\n"
+        "do I < 100 {\n"
+        "    B = A\n"
+        "    C = A # + I\n"
+        "    I = I + 1\n"
+        "}\n"
+        "C\n";
+
+    report("100 reads of a 1000000 number variable", runScript(source, {0.0}, 5));
+}
+
+// each operator of the chain has an expiring left parameter
+void benchmarkChainedOperators()
+{
+    std::string source = 
+        "A = 1000000 i\n"
+        "I = 0\n"
+        "do I < 10 {\n"
+        "    B = (A % 3 == 0) * 2 + A - 1\n"
+        "    I = I + 1\n"
+        "}\n"
+        "B # \n";
+
+    report("10 chains of 5 operators on 1000000 numbers", runScript(source, {0.0}, 5));
+}
+
+// the range is summed without storing its numbers
+void benchmarkRangeSum()
+{
+    report("sum of 1000000000 i", runScript("1000000000 i #+\n", {0.0}, 5));
+}
+
+// the text is stored as bytes and the comparisons give booleans
+void benchmarkTextScan()
+{
+    std::string source = 
+        "T = \"the quick brown fox jumps over the lazy dog \" : (10000000 i % 44 + 1)\n"
+        "I = 0\n"
+        "do I < 10 {\n"
+        "    W = (T == \" \") #+\n"
+        "    U = T <- \"aeiou\" #\n"
+        "    I = I + 1\n"
+        "}\n"
+        "W\n";
+
+    report("10 word and vowel counts of 10000000 characters", runScript(source, {0.0}, 3));
+}
+
+// every async block reads the shared numbers and writes its own variables, like async_primes.txt
+void benchmarkElementWise()
+{
+    std::string source = 
+        "X = 1000000 i * 1.5 + 0\n"
+        "I = 0\n"
+        "do I < 20 {\n"
+        "    Y = X * X + X / 3 % 7 ** 2 < X\n"
+        "    Y = Y + (X - 1,2,3)\n"
+        "    I = I + 1\n"
+        "}\n";
+
+    report("20 element wise chains over 1000000 numbers", runScript(source, {0.0}, 3));
+}
+
+// the operators of each run are calculated element by element without storing their intermediate arrays
+void benchmarkFusion(bool isFusion)
+{
+    std::string source = 
+        "X = 4000000 i * 1.5 + 0\n"
+        "I = 0\n"
+        "do I < 10 {\n"
+        "    S = (X % 2 == 0) * X #+\n"
+        "    C = X * 2 - 1 / 3 < 5000 #+\n"
+        "    I = I + 1\n"
+        "}\n";
+
+    BytecodeCompiler::setFusion(isFusion);
+    report(std::string("10 sums of element wise runs over 4000000 numbers") + (isFusion ? " fused" : " unfused"), runScript(source, {0.0}, 3));
+    BytecodeCompiler::setFusion(true);
+}
+
+// constants are folded when the program is compiled, repeated parenthesis are calculated once per call
+void benchmarkOptimizer(bool isOptimization)
+{
+    std::string source =
+        "f MULTIPLES { ((b - a)i * 3 - 0.5) : (((b - a)i * 3 - 0.5) % 7 == 0) }\n"
+        "f UPPER { a + (\"A\" - \"a\") * (3 i + 1 - 1 > 0) }\n"
+        "I = 0; S = 0\n"
+        "do I < 2000 {\n"
+        "    S = S + (1 MULTIPLES 5000 #+) + (\"abc\" UPPER #+)\n"
+        "    I = I + 1\n"
+        "}\n"
+        "S\n";
+
+    Optimizer::setOptimization(isOptimization);
+    report(std::string("2000 calls with repeated parenthesis and constants") + (isOptimization ? " optimized" : " unoptimized"), runScript(source, {0.0}, 3));
+    Optimizer::setOptimization(true);
+}
+
+// rule110.txt with a wide state, invariant parenthesis of the loops are calculated once per loop
+void benchmarkLoopInvariants(bool isOptimization)
+{
+    const std::string filepath = "examples/rule110.txt";
+    const int size = 2000;
+    const int steps = 5;
+    std::string source;
+    assert(FileReader::read(filepath, source));
+    assert(source.compare(0, 10, "SIZE = 100") == 0);
+    source = "SIZE = " + std::to_string(size) + source.substr(10);
+
+    Optimizer::setOptimization(isOptimization);
+    unsigned long long instructions;
+    const double milliseconds = runScript(source, {(double)steps}, 3, InterpreterEngineBytecode, &instructions);
+    report(filepath + " with SIZE = " + std::to_string(size) + (isOptimization ? " optimized" : " unoptimized"), milliseconds);
+    const int iterations = steps * (size - 2);
+    std::cout << filepath << ": " << milliseconds * 1e6 / iterations << " ns and "
+        << (double)instructions / iterations << " instructions per iteration" << std::endl;
+    Optimizer::setOptimization(true);
+}
+
+// the condition and the step of the loop compare and add numbers without the stack
+void benchmarkCountedLoop(bool isCounted)
+{
+    std::string source =
+        "I = 1\n"
+        "S = 0\n"
+        "do I <= 1000000 {\n"
+        "    S = S + I\n"
+        "    I = I + 1\n"
+        "}\n";
+
+    BytecodeCompiler::setCountedLoops(isCounted);
+    unsigned long long instructions;
+    const double milliseconds = runScript(source, {0.0}, 3, InterpreterEngineBytecode, &instructions);
+    report(std::string("1000000 iterations of a counted loop") + (isCounted ? " counted" : " uncounted"), milliseconds);
+    std::cout << "counted loop: " << (double)instructions / 1000000 << " instructions per iteration" << std::endl;
+    BytecodeCompiler::setCountedLoops(true);
+}
+
+// 100000 calls with 500 distinct parameters, each call runs over a few thousand numbers
+void benchmarkMemoization(bool isMemoization)
+{
+    std::string source =
+        "f ISPRIME {\n"
+        "    ( a % (a - 2 i + 1) #* ) + (a == 2)\n"
+        "}\n"
+        "100000 i % 500 + 2000 \\ ISPRIME #+\n";
+
+    Interpreter::setMemoization(isMemoization);
+    report(std::string("100000 i % 500 + 2000 \\ ISPRIME") + (isMemoization ? " memoized" : " unmemoized"), runScript(source, {0.0}, 3));
+    Interpreter::setMemoization(false);
+}
+
+void benchmarkApplyToEach()
+{
+    std::string source = 
+        "f ISPRIME {\n"
+        "    ( a % (a - 2 i + 1) #* ) + (a == 2)\n"
+        "}\n"
+        "5000 i \\ ISPRIME #+\n";
+
+    report("5000 i \\ ISPRIME with " + std::to_string(ThreadPool::getInstance().getSize()) + " threads", runScript(source, {0.0}, 3));
+}
+
+void benchmarkApplyOperatorToEach()
+{
+    report("1000000 i \\ + and \\ <", runScript("X = 1000000 i\nX \\ + #+ + (X \\ < #+)\n", {0.0}, 5));
+}
+
+// the shuffled numbers are a temporary, so they are sorted in place
+void benchmarkSort()
+{
+    report("sort 10000000 shuffled numbers", runScript("10000000 i * 7919 % 10000019 - 5000000 $ #\n", {0.0}, 3));
+}
+
+// at most 1000003 distinct numbers that aren't integers, so they are hashed,
+// or character codes below 128 that are looked up directly
+void benchmarkSetOperators(size_t size, bool isCharacterCodes)
+{
+    const size_t distinct = isCharacterCodes ? 128 : 1000003;
+    const double offset = isCharacterCodes ? 0.0 : 0.5;
+    Value numbers;
+    numbers.resize(size);
+    double* data = numbers.mutableData();
+    for(size_t i=0; i<size; i++)
+        data[i] = (double)(i * 7919 % distinct) + offset;
+    Value lookup;
+    for(double number: {0.0, 7.0, 100.0, 1000.0, 50000.0, 123456.0, 999999.0, 3.0,
+        11.0, 13.0, 17.0, 19.0, 23.0, 29.0, 31.0, 37.0, 41.0, 43.0, 47.0, 53.0})
+        lookup.push_back(isCharacterCodes ? (double)((size_t)number % distinct) : number + offset);
+
+    const int repeats = size < 10000000 ? 10 : 1;
+    bool hadError = false;
+    Value result;
+    const auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<repeats; i++){
+        InterpreterCalculator::makeSet(numbers, result, hadError, nullptr);
+        InterpreterCalculator::remove(numbers, lookup, result, hadError, nullptr);
+        InterpreterCalculator::countEach(numbers, lookup, result, hadError, nullptr);
+        InterpreterCalculator::remain(lookup, numbers, result, hadError, nullptr);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    report("makeSet, remove, countEach and remain of " + std::to_string(size) + (isCharacterCodes ? " character codes" : " numbers"),
+        std::chrono::duration<double, std::milli>(end - start).count() / repeats);
+}
+
+void benchmarkReduction(int tasks, bool isCompensated)
+{
+    const int repeats = 10;
+    Value numbers;
+    numbers.resize(8000000, 0.1);
+    InterpreterCalculator::setReductionTasks(tasks);
+    InterpreterCalculator::setCompensatedSum(isCompensated);
+
+    bool hadError = false;
+    Value result;
+    const auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<repeats; i++)
+        InterpreterCalculator::sumAll(numbers, result, hadError, nullptr);
+    const auto end = std::chrono::steady_clock::now();
+    InterpreterCalculator::setReductionTasks(0);
+    InterpreterCalculator::setCompensatedSum(false);
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << (isCompensated ? "compensated" : "fast") << " #+ of 8000000 numbers in " << tasks << " tasks: " <<
+        repeats * numbers.size() * sizeof(double) / seconds / 1e9 << " GB/s" << std::endl;
+}
+
+void benchmarkProduct(int tasks)
+{
+    const int repeats = 10;
+    Value numbers;
+    // the running products stay normal, so the blocks are combined instead of multiplied again in order
+    numbers.resize(8000000, 1.0000001);
+    InterpreterCalculator::setReductionTasks(tasks);
+
+    bool hadError = false;
+    Value result;
+    const auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<repeats; i++)
+        InterpreterCalculator::multiplyAll(numbers, result, hadError, nullptr);
+    const auto end = std::chrono::steady_clock::now();
+    InterpreterCalculator::setReductionTasks(0);
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "#* of 8000000 numbers in " << tasks << " tasks: " <<
+        repeats * numbers.size() * sizeof(double) / seconds / 1e9 << " GB/s" << std::endl;
+}
+
+void benchmarkConcurrentVariables(int threads)
+{
+    const int iterations = 20000;
+    std::string source = "A = 1,2,3\nB = 4\n";
+    for(int i=0; i<threads; i++){
+        const std::string index = std::to_string(i);
+        source +=
+            "[\n"
+            "    I" + index + " = 0\n"
+            "    do I" + index + " < " + std::to_string(iterations) + " {\n"
+            "        X" + index + " = A #+ + B\n"
+            "        I" + index + " = I" + index + " + 1\n"
+            "    }\n"
+            "]\n";
+    }
+    source += "!!\n";
+
+    // 4 reads and 2 writes per iteration
+    const double milliseconds = runScript(source, {0.0}, 5);
+    std::cout << threads << " async blocks: " << milliseconds << " ms, " <<
+        6.0 * iterations * threads / milliseconds / 1000.0 << " million variable accesses per second" << std::endl;
+}
+
+void benchmarkAsyncLatency(int blocks)
+{
+    const int iterations = 2000;
+    std::string source = "I = 0\ndo I < " + std::to_string(iterations) + " {\n";
+    for(int i=0; i<blocks; i++)
+        source += "    [X" + std::to_string(i) + " = I]\n";
+    source += "    !!\n    I = I + 1\n}\n";
+
+    const double milliseconds = runScript(source, {0.0}, 5);
+    std::cout << "spawn " << blocks << " async blocks and join: " << 1000.0 * milliseconds / iterations << " us" << std::endl;
+}
+
+int main(){
+    benchmarkLoopWithIf();
+    benchmarkLargeVariableReads();
+    benchmarkChainedOperators();
+    benchmarkRangeSum();
+    benchmarkTextScan();
+    benchmarkElementWise();
+    benchmarkFusion(false);
+    benchmarkFusion(true);
+    benchmarkOptimizer(false);
+    benchmarkOptimizer(true);
+    benchmarkLoopInvariants(false);
+    benchmarkLoopInvariants(true);
+    benchmarkCountedLoop(false);
+    benchmarkCountedLoop(true);
+    benchmarkMemoization(false);
+    benchmarkMemoization(true);
+    benchmarkApplyToEach();
+    benchmarkApplyOperatorToEach();
+    benchmarkSort();
+    for(size_t size=1000; size<=100000000; size*=10)
+        benchmarkSetOperators(size, false);
+    benchmarkSetOperators(10000000, true);
+    for(int threads=1; threads<=std::max(4u, std::thread::hardware_concurrency()); threads*=2)
+        benchmarkConcurrentVariables(threads);
+    for(int tasks=1; tasks<=ThreadPool::getInstance().getSize(); tasks*=2){
+        benchmarkReduction(tasks, false);
+        benchmarkReduction(tasks, true);
+        benchmarkProduct(tasks);
+    }
+    benchmarkAsyncLatency(1);
+    benchmarkAsyncLatency(4);
+    benchmarkDispatch("examples/rule110.txt", {100.0}, 5);
+    benchmarkDispatch("examples/primes.txt", {2000.0}, 5);
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "SyntaxTree.h"
+
+enum Opcode{
+    // push a value
+    OpcodeLiteral,
+    OpcodeVariable,
+    OpcodeLeftParam,
+    OpcodeRightParam,
+    OpcodeRead,
+    OpcodeReadText,
+    OpcodeEmpty,
+    OpcodeEvaluate,
+    OpcodeCall,
+    OpcodeCallWithParameters,
+    OpcodeApplyToEach,
+    OpcodeHandOverIfEmpty,
+    // replaces the value on top of the stack with the value of a fused expression and jumps past its operators,
+    // or continues with them when the expression can't be fused
+    OpcodeFused,
+    // empties argument slots of common parenthesis from the slot common, when a statement or a loop starts
+    OpcodeClearCommon,
+    // pushes the value of a common parenthesis and jumps past it if the slot has one, or continues with it
+    OpcodeLoadCommon,
+    // OpcodeLoadCommon for a parenthesis invariant in a loop, it is calculated again while async blocks may run
+    OpcodeLoadInvariant,
+    // copies the value on top of the stack to its slot
+    OpcodeStoreCommon,
+    // jumps into the body or past a counted loop if its variable and limit are single numbers,
+    // or continues with the instructions of the condition
+    OpcodeCountedCondition,
+    // adds the step to the single number of the variable of a counted loop and jumps past the assignment,
+    // or continues with its instructions
+    OpcodeCountedStep,
+    // operators, pop the right and left parameter and push the result
+    OpcodeAdd,
+    OpcodeSubtract,
+    OpcodeMultiply,
+    OpcodeDivide,
+    OpcodeMod,
+    OpcodePower,
+    OpcodeLessThan,
+    OpcodeGreaterThan,
+    OpcodeLessThanOrEquals,
+    OpcodeGreaterThanOrEquals,
+    OpcodeIsEquals,
+    OpcodeNotEquals,
+    OpcodeUnion,
+    OpcodeSelect,
+    OpcodeLeftRotate,
+    OpcodeRightRotate,
+    OpcodeRemove,
+    OpcodeRemain,
+    OpcodeCountEach,
+    OpcodeIterate,
+    OpcodeLogicalNot,
+    OpcodeCount,
+    OpcodeSumAll,
+    OpcodeMultiplyAll,
+    OpcodeRandom,
+    OpcodeSine,
+    OpcodeConvert,
+    OpcodeMakeSet,
+    OpcodeCeil,
+    OpcodeFloor,
+    OpcodeRound,
+    OpcodeSort,
+    OpcodeReverse,
+    // statements, pop their value
+    OpcodeSetLastResult,
+    OpcodeAssign,
+    OpcodeWrite,
+    OpcodeWriteText,
+    OpcodeJump,
+    OpcodeJumpIfFalse,
+    OpcodeAsync,
+    OpcodeJoin,
+    OpcodeReturn,
+    OpcodeNumberOfOpcodes
+};
+
+struct BytecodeBlock;
+
+// where the token interpreter continues when a value on top of the stack is empty
+struct BytecodeHandOver{
+    const SyntaxBlock* source;
+    int position;
+    // pending operation, the left and right parameter are on the stack
+    const Token* operation;
+    // loops the instruction is in (outermost first)
+    std::vector<const SyntaxNode*> loops;
+    // the block returns the result of the token interpreter,
+    // or the result is pushed and execution continues at exit (end of an inlined block)
+    int exit;
+
+    static const int EXIT_RETURN = -1;
+};
+
+// a run of element wise operators, optionally reduced, that is evaluated element by element
+// without storing the intermediate arrays
+struct FusedExpression{
+    // postfix, OpcodeEmpty pushes the value on top of the stack, OpcodeLiteral, OpcodeVariable, OpcodeLeftParam and
+    // OpcodeRightParam push their value, arithmetic and comparison operators replace the top two values with their result
+    std::vector<Opcode> steps;
+    // tokens of the literals and variables, in the order of their steps
+    std::vector<const Token*> tokens;
+    // OpcodeSumAll, OpcodeMultiplyAll, OpcodeCount, or OpcodeEmpty if the result is the array
+    Opcode reduction = OpcodeEmpty;
+};
+
+// a loop whose condition compares a variable with a limit and whose body assigns the variable plus a step,
+// both are calculated on the numbers in place of the variable while it holds one number
+struct CountedLoop{
+    const Token* variable;
+    // OpcodeLessThan, OpcodeGreaterThan, OpcodeLessThanOrEquals or OpcodeGreaterThanOrEquals
+    Opcode comparison;
+    // literal or variable
+    const Token* limit;
+    // the literal of '+', or the negated literal of '-'
+    double step;
+};
+
+struct Instruction{
+    Opcode opcode;
+    // jump target, or position of the token in the source block
+    int argument = 0;
+    // literal, variable or modified operator
+    const Token* token = nullptr;
+    // errors are reported in the tokens of the source block
+    const SyntaxBlock* source = nullptr;
+    // called function, evaluated or async block
+    const BytecodeBlock* block = nullptr;
+    const BytecodeHandOver* handOver = nullptr;
+    const FusedExpression* fused = nullptr;
+    const CountedLoop* counted = nullptr;
+    // slot of a common parenthesis
+    int common = 0;
+};
+
+struct BytecodeBlock{
+    // executed by the token interpreter if the source was not compiled
+    const SyntaxBlock* source = nullptr;
+    std::vector<Instruction> code;
+    std::vector<std::unique_ptr<BytecodeHandOver>> handOvers;
+    std::vector<std::unique_ptr<FusedExpression>> fusedExpressions;
+    std::vector<std::unique_ptr<CountedLoop>> countedLoops;
+    // slots for the values of common parenthesis
+    int commonValues = 0;
+    // results of a memoized function, set by the interpreter
+    MemoCache* memoCache = nullptr;
+    // blocks that were not inlined
+    std::vector<std::unique_ptr<BytecodeBlock>> blocks;
+};
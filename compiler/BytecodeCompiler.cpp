@@ -0,0 +1,568 @@
+#include "BytecodeCompiler.h"
+
+bool BytecodeCompiler::isFusion = true;
+bool BytecodeCompiler::isCountedLoops = true;
+
+void BytecodeCompiler::setFusion(bool isEnabled)
+{
+    isFusion = isEnabled;
+}
+
+void BytecodeCompiler::setCountedLoops(bool isEnabled)
+{
+    isCountedLoops = isEnabled;
+}
+
+void BytecodeCompiler::compileFunctions(
+    const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+    std::unordered_map<std::string, BytecodeBlock>& bytecodeFunctions)
+{
+    // every function gets its block first so calls can point to functions compiled later
+    bytecodeFunctions.clear();
+    for(const auto& function: compiledFunctions)
+        bytecodeFunctions[function.first];
+
+    const Context context = makeContext(compiledFunctions, bytecodeFunctions);
+    for(const auto& function: compiledFunctions)
+        compileBlock(function.second, context, bytecodeFunctions[function.first]);
+}
+
+void BytecodeCompiler::compile(
+    const SyntaxBlock& block,
+    const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+    const std::unordered_map<std::string, BytecodeBlock>& bytecodeFunctions,
+    BytecodeBlock& bytecode)
+{
+    compileBlock(block, makeContext(compiledFunctions, bytecodeFunctions), bytecode);
+}
+
+BytecodeCompiler::Context BytecodeCompiler::makeContext(
+    const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+    const std::unordered_map<std::string, BytecodeBlock>& bytecodeFunctions)
+{
+    Context context;
+    for(const auto& function: compiledFunctions){
+        const auto bytecodeFunction = bytecodeFunctions.find(function.first);
+        if(bytecodeFunction != bytecodeFunctions.end())
+            context.functions[&function.second] = &bytecodeFunction->second;
+    }
+    return context;
+}
+
+void BytecodeCompiler::compileBlock(const SyntaxBlock& block, const Context& context, BytecodeBlock& bytecode)
+{
+    bytecode.source = &block;
+    bytecode.code.clear();
+    bytecode.handOvers.clear();
+    bytecode.fusedExpressions.clear();
+    bytecode.countedLoops.clear();
+    bytecode.commonValues = block.commonValues;
+    bytecode.blocks.clear();
+    if(!block.isCompiled)
+        return;
+
+    std::vector<const SyntaxNode*> loops;
+    for(const auto& statement: block.statements)
+        compileStatement(statement, block, loops, context, bytecode);
+    addInstruction(bytecode, OpcodeReturn, 0, &block);
+}
+
+void BytecodeCompiler::compileStatement(
+    const SyntaxNode& statement,
+    const SyntaxBlock& source,
+    std::vector<const SyntaxNode*>& loops,
+    const Context& context,
+    BytecodeBlock& bytecode)
+{
+    switch(statement.type){
+        case SyntaxNodeAssign:
+        case SyntaxNodeWrite:
+        case SyntaxNodeWriteText:
+        {
+            addClearCommon(statement, source, bytecode);
+            compileValue(*statement.block, context, bytecode);
+            const Opcode opcode = statement.type == SyntaxNodeAssign ? OpcodeAssign : statement.type == SyntaxNodeWrite ? OpcodeWrite : OpcodeWriteText;
+            const int instruction = addInstruction(bytecode, opcode, statement.position, &source);
+            bytecode.code[instruction].token = statement.token;
+            return;
+        }
+        case SyntaxNodeIf:
+        {
+            addClearCommon(statement, source, bytecode);
+            compileValue(*statement.block, context, bytecode);
+            const int jump = addInstruction(bytecode, OpcodeJumpIfFalse, 0, &source);
+            for(const auto& child: statement.children)
+                compileStatement(child, source, loops, context, bytecode);
+            bytecode.code[jump].argument = bytecode.code.size();
+            return;
+        }
+        case SyntaxNodeLoop:
+        {
+            if(statement.invariantValues != 0){
+                const int clear = addInstruction(bytecode, OpcodeClearCommon, statement.invariantValues, &source);
+                bytecode.code[clear].common = statement.firstInvariant;
+            }
+            auto counted = std::make_unique<CountedLoop>();
+            const bool isCounted = isCountedLoops && getCountedLoop(statement, *counted);
+            const int condition = bytecode.code.size();
+            if(isCounted){
+                const int countedCondition = addInstruction(bytecode, OpcodeCountedCondition, 0, &source);
+                bytecode.code[countedCondition].counted = counted.get();
+            }
+            addClearCommon(statement, source, bytecode);
+            compileValue(*statement.block, context, bytecode);
+            const int jump = addInstruction(bytecode, OpcodeJumpIfFalse, 0, &source);
+            // the counted condition continues after the jump or at its target
+            if(isCounted)
+                bytecode.code[condition].argument = jump;
+            loops.push_back(&statement);
+            for(const auto& child: statement.children){
+                if(!isCounted || !isCountedStep(child, *counted->variable)){
+                    compileStatement(child, source, loops, context, bytecode);
+                    continue;
+                }
+                const int step = addInstruction(bytecode, OpcodeCountedStep, child.position, &source);
+                bytecode.code[step].counted = counted.get();
+                compileStatement(child, source, loops, context, bytecode);
+                bytecode.code[step].argument = bytecode.code.size();
+            }
+            loops.pop_back();
+            if(isCounted)
+                bytecode.countedLoops.push_back(std::move(counted));
+            addInstruction(bytecode, OpcodeJump, condition, &source);
+            bytecode.code[jump].argument = bytecode.code.size();
+            return;
+        }
+        case SyntaxNodeAsync:
+        {
+            auto block = std::make_unique<BytecodeBlock>();
+            compileBlock(*statement.block, context, *block);
+            const int instruction = addInstruction(bytecode, OpcodeAsync, statement.position, &source);
+            bytecode.code[instruction].block = block.get();
+            bytecode.blocks.push_back(std::move(block));
+            return;
+        }
+        case SyntaxNodeJoin:
+        {
+            addInstruction(bytecode, OpcodeJoin, statement.position, &source);
+            return;
+        }
+        default:
+        {
+            addClearCommon(statement, source, bytecode);
+            compileExpression(statement, source, loops, false, context, bytecode);
+            addInstruction(bytecode, OpcodeSetLastResult, statement.position, &source);
+            return;
+        }
+    }
+}
+
+void BytecodeCompiler::compileValue(const SyntaxBlock& block, const Context& context, BytecodeBlock& bytecode)
+{
+    if(!isInlinable(block)){
+        auto evaluated = std::make_unique<BytecodeBlock>();
+        compileBlock(block, context, *evaluated);
+        const int instruction = addInstruction(bytecode, OpcodeEvaluate, 0, &block);
+        bytecode.code[instruction].block = evaluated.get();
+        bytecode.blocks.push_back(std::move(evaluated));
+        return;
+    }
+
+    const size_t firstHandOver = bytecode.handOvers.size();
+    const std::vector<const SyntaxNode*> noLoops;
+    compileExpression(block.statements[0], block, noLoops, true, context, bytecode);
+    for(size_t i=firstHandOver; i<bytecode.handOvers.size(); i++){
+        if(bytecode.handOvers[i]->exit == EXIT_PENDING)
+            bytecode.handOvers[i]->exit = bytecode.code.size();
+    }
+}
+
+void BytecodeCompiler::compileExpression(
+    const SyntaxNode& expression,
+    const SyntaxBlock& source,
+    const std::vector<const SyntaxNode*>& loops,
+    bool isInlined,
+    const Context& context,
+    BytecodeBlock& bytecode)
+{
+    compileNode(expression, source, loops, isInlined, context, bytecode);
+    if(expression.type != SyntaxNodeEmpty)
+        addHandOver(source, expression.position, nullptr, loops, isInlined, bytecode);
+}
+
+void BytecodeCompiler::compileNode(
+    const SyntaxNode& node,
+    const SyntaxBlock& source,
+    const std::vector<const SyntaxNode*>& loops,
+    bool isInlined,
+    const Context& context,
+    BytecodeBlock& bytecode)
+{
+    int instruction;
+    switch(node.type)
+    {
+    case SyntaxNodeLiteral:
+        instruction = addInstruction(bytecode, OpcodeLiteral, node.position, &source);
+        bytecode.code[instruction].token = node.token;
+        return;
+    case SyntaxNodeVariable:
+        instruction = addInstruction(bytecode, OpcodeVariable, node.position, &source);
+        bytecode.code[instruction].token = node.token;
+        return;
+    case SyntaxNodeLeftParam:
+        addInstruction(bytecode, OpcodeLeftParam, node.position, &source);
+        return;
+    case SyntaxNodeRightParam:
+        addInstruction(bytecode, OpcodeRightParam, node.position, &source);
+        return;
+    case SyntaxNodeRead:
+        addInstruction(bytecode, OpcodeRead, node.position, &source);
+        return;
+    case SyntaxNodeReadText:
+        addInstruction(bytecode, OpcodeReadText, node.position, &source);
+        return;
+    case SyntaxNodeGroup:
+    {
+        if(node.common == SyntaxNode::NOT_COMMON){
+            compileValue(*node.block, context, bytecode);
+            return;
+        }
+
+        // handovers in the parenthesis exit to the store
+        const int load = addInstruction(bytecode, node.isInvariant ? OpcodeLoadInvariant : OpcodeLoadCommon, 0, &source);
+        bytecode.code[load].common = node.common;
+        compileValue(*node.block, context, bytecode);
+        instruction = addInstruction(bytecode, OpcodeStoreCommon, node.position, &source);
+        bytecode.code[instruction].common = node.common;
+        bytecode.code[load].argument = bytecode.code.size();
+        return;
+    }
+    case SyntaxNodeCall:
+        instruction = addInstruction(bytecode, OpcodeCall, node.position, &source);
+        bytecode.code[instruction].block = context.functions.at(node.function);
+        return;
+    case SyntaxNodeOperation:
+    {
+        auto fused = std::make_unique<FusedExpression>();
+        if(isFusion && getFusedExpression(node, *fused)){
+            compileFused(node, std::move(fused), source, loops, isInlined, context, bytecode);
+            return;
+        }
+
+        compileExpression(node.children[0], source, loops, isInlined, context, bytecode);
+        if(node.children.size() > 1){
+            compileNode(node.children[1], source, loops, isInlined, context, bytecode);
+            addHandOver(source, node.children[1].position, node.token, loops, isInlined, bytecode);
+        }else if(node.function != nullptr){
+            // functions always take both parameters
+            addInstruction(bytecode, OpcodeEmpty, node.position, &source);
+        }
+
+        Opcode opcode;
+        if(node.function != nullptr){
+            instruction = addInstruction(bytecode, OpcodeCallWithParameters, node.position, &source);
+            bytecode.code[instruction].block = context.functions.at(node.function);
+        }else if(getOperatorOpcode(node.token->id, opcode)){
+            addInstruction(bytecode, opcode, node.position, &source);
+        }
+        return;
+    }
+    case SyntaxNodeApplyToEach:
+        compileExpression(node.children[0], source, loops, isInlined, context, bytecode);
+        instruction = addInstruction(bytecode, OpcodeApplyToEach, node.position-1, &source);
+        bytecode.code[instruction].token = node.token;
+        return;
+    default:
+        addInstruction(bytecode, OpcodeEmpty, node.position, &source);
+        return;
+    }
+}
+
+bool BytecodeCompiler::getFusedExpression(const SyntaxNode& node, FusedExpression& fused)
+{
+    const SyntaxNode* run = &node;
+    int minOperators = MIN_FUSED_OPERATORS;
+    const TokenId id = node.token->id;
+    if(node.function == nullptr && node.children.size() == 1 && (id == TokenIdSumAll || id == TokenIdMultiplyAll || id == TokenIdCount)){
+        getOperatorOpcode(id, fused.reduction);
+        run = &node.children[0];
+        minOperators = MIN_REDUCED_FUSED_OPERATORS;
+    }else if(!isFusibleOperation(node)){
+        return false;
+    }
+
+    if(!addFusedRun(*run, fused))
+        return false;
+
+    int operators = 0;
+    for(const auto step: fused.steps){
+        if(step >= OpcodeAdd)
+            operators++;
+    }
+    return operators >= minOperators;
+}
+
+bool BytecodeCompiler::isFusibleOperation(const SyntaxNode& node)
+{
+    Opcode opcode;
+    return node.type == SyntaxNodeOperation && node.function == nullptr && node.children.size() == 2 &&
+        getOperatorOpcode(node.token->id, opcode) && opcode >= OpcodeAdd && opcode <= OpcodeNotEquals;
+}
+
+bool BytecodeCompiler::isFusibleGroup(const SyntaxNode& node)
+{
+    return node.type == SyntaxNodeGroup && isInlinable(*node.block);
+}
+
+bool BytecodeCompiler::addFusedRun(const SyntaxNode& node, FusedExpression& fused)
+{
+    if(isFusibleOperation(node)){
+        Opcode opcode;
+        getOperatorOpcode(node.token->id, opcode);
+        if(!addFusedRun(node.children[0], fused) || !addFusedOperand(node.children[1], fused))
+            return false;
+        fused.steps.push_back(opcode);
+        return true;
+    }
+    // a common parenthesis is the value on the stack, it may be reused
+    if(isFusibleGroup(node) && node.common == SyntaxNode::NOT_COMMON)
+        return addFusedRun(node.block->statements[0], fused);
+
+    fused.steps.push_back(OpcodeEmpty);
+    return true;
+}
+
+bool BytecodeCompiler::addFusedOperand(const SyntaxNode& node, FusedExpression& fused)
+{
+    // a run in parenthesis starts with an operand instead of the value on the stack
+    if(isFusibleOperation(node)){
+        Opcode opcode;
+        getOperatorOpcode(node.token->id, opcode);
+        if(!addFusedOperand(node.children[0], fused) || !addFusedOperand(node.children[1], fused))
+            return false;
+        fused.steps.push_back(opcode);
+        return true;
+    }
+
+    switch(node.type)
+    {
+    case SyntaxNodeLiteral:
+        fused.steps.push_back(OpcodeLiteral);
+        fused.tokens.push_back(node.token);
+        return true;
+    case SyntaxNodeVariable:
+        fused.steps.push_back(OpcodeVariable);
+        fused.tokens.push_back(node.token);
+        return true;
+    case SyntaxNodeLeftParam:
+        fused.steps.push_back(OpcodeLeftParam);
+        return true;
+    case SyntaxNodeRightParam:
+        fused.steps.push_back(OpcodeRightParam);
+        return true;
+    case SyntaxNodeGroup:
+        return isFusibleGroup(node) && addFusedOperand(node.block->statements[0], fused);
+    default:
+        return false;
+    }
+}
+
+void BytecodeCompiler::compileFused(
+    const SyntaxNode& node,
+    std::unique_ptr<FusedExpression> fused,
+    const SyntaxBlock& source,
+    const std::vector<const SyntaxNode*>& loops,
+    bool isInlined,
+    const Context& context,
+    BytecodeBlock& bytecode)
+{
+    int fusedInstruction = -1;
+    if(fused->reduction != OpcodeEmpty){
+        compileFusedExpression(node.children[0], source, loops, isInlined, context, bytecode, fusedInstruction);
+        addInstruction(bytecode, fused->reduction, node.position, &source);
+    }else{
+        compileFusedNode(node, source, loops, isInlined, context, bytecode, fusedInstruction);
+    }
+
+    // the fused instruction continues after the last operator
+    bytecode.code[fusedInstruction].argument = bytecode.code.size();
+    bytecode.code[fusedInstruction].fused = fused.get();
+    bytecode.fusedExpressions.push_back(std::move(fused));
+}
+
+void BytecodeCompiler::compileFusedExpression(
+    const SyntaxNode& expression,
+    const SyntaxBlock& source,
+    const std::vector<const SyntaxNode*>& loops,
+    bool isInlined,
+    const Context& context,
+    BytecodeBlock& bytecode,
+    int& fusedInstruction)
+{
+    compileFusedNode(expression, source, loops, isInlined, context, bytecode, fusedInstruction);
+    if(expression.type != SyntaxNodeEmpty)
+        addHandOver(source, expression.position, nullptr, loops, isInlined, bytecode);
+
+    // the first expression that ends is the left parameter of the innermost operation
+    if(fusedInstruction < 0)
+        fusedInstruction = addInstruction(bytecode, OpcodeFused, expression.position, &source);
+}
+
+void BytecodeCompiler::compileFusedNode(
+    const SyntaxNode& node,
+    const SyntaxBlock& source,
+    const std::vector<const SyntaxNode*>& loops,
+    bool isInlined,
+    const Context& context,
+    BytecodeBlock& bytecode,
+    int& fusedInstruction)
+{
+    if(isFusibleOperation(node)){
+        compileFusedExpression(node.children[0], source, loops, isInlined, context, bytecode, fusedInstruction);
+        compileNode(node.children[1], source, loops, isInlined, context, bytecode);
+        addHandOver(source, node.children[1].position, node.token, loops, isInlined, bytecode);
+        Opcode opcode;
+        getOperatorOpcode(node.token->id, opcode);
+        addInstruction(bytecode, opcode, node.position, &source);
+        return;
+    }
+
+    if(!isFusibleGroup(node) || node.common != SyntaxNode::NOT_COMMON){
+        compileNode(node, source, loops, isInlined, context, bytecode);
+        return;
+    }
+
+    // like compileValue
+    const size_t firstHandOver = bytecode.handOvers.size();
+    const std::vector<const SyntaxNode*> noLoops;
+    compileFusedExpression(node.block->statements[0], *node.block, noLoops, true, context, bytecode, fusedInstruction);
+    for(size_t i=firstHandOver; i<bytecode.handOvers.size(); i++){
+        if(bytecode.handOvers[i]->exit == EXIT_PENDING)
+            bytecode.handOvers[i]->exit = bytecode.code.size();
+    }
+}
+
+void BytecodeCompiler::addClearCommon(const SyntaxNode& statement, const SyntaxBlock& source, BytecodeBlock& bytecode)
+{
+    if(statement.commonValues == 0)
+        return;
+
+    const int instruction = addInstruction(bytecode, OpcodeClearCommon, statement.commonValues, &source);
+    bytecode.code[instruction].common = statement.firstCommon;
+}
+
+void BytecodeCompiler::addHandOver(
+    const SyntaxBlock& source,
+    int position,
+    const Token* operation,
+    const std::vector<const SyntaxNode*>& loops,
+    bool isInlined,
+    BytecodeBlock& bytecode)
+{
+    auto handOver = std::make_unique<BytecodeHandOver>();
+    handOver->source = &source;
+    handOver->position = position;
+    handOver->operation = operation;
+    handOver->loops = loops;
+    handOver->exit = isInlined ? EXIT_PENDING : BytecodeHandOver::EXIT_RETURN;
+
+    const int instruction = addInstruction(bytecode, OpcodeHandOverIfEmpty, position, &source);
+    bytecode.code[instruction].handOver = handOver.get();
+    bytecode.handOvers.push_back(std::move(handOver));
+}
+
+int BytecodeCompiler::addInstruction(BytecodeBlock& bytecode, Opcode opcode, int argument, const SyntaxBlock* source)
+{
+    Instruction instruction;
+    instruction.opcode = opcode;
+    instruction.argument = argument;
+    instruction.source = source;
+    bytecode.code.push_back(instruction);
+    return bytecode.code.size() - 1;
+}
+
+bool BytecodeCompiler::isInlinable(const SyntaxBlock& block)
+{
+    // the value of a block with one expression is the value of the expression
+    return block.isCompiled && block.statements.size() == 1 && block.statements[0].type < SyntaxNodeAssign;
+}
+
+bool BytecodeCompiler::getCountedLoop(const SyntaxNode& loop, CountedLoop& counted)
+{
+    if(!isInlinable(*loop.block))
+        return false;
+
+    const SyntaxNode& condition = loop.block->statements[0];
+    if(condition.type != SyntaxNodeOperation || condition.function != nullptr || condition.children.size() != 2 ||
+        condition.children[0].type != SyntaxNodeVariable || !getOperatorOpcode(condition.token->id, counted.comparison) ||
+        counted.comparison < OpcodeLessThan || counted.comparison > OpcodeGreaterThanOrEquals)
+        return false;
+
+    const SyntaxNode& limit = condition.children[1];
+    if(limit.type != SyntaxNodeVariable && (limit.type != SyntaxNodeLiteral || limit.token->val.size() != 1))
+        return false;
+
+    counted.variable = condition.children[0].token;
+    counted.limit = limit.token;
+    for(const auto& statement: loop.children){
+        if(isCountedStep(statement, *counted.variable)){
+            const SyntaxNode& step = statement.block->statements[0];
+            counted.step = step.token->id == TokenIdAdd ? step.children[1].token->val[0] : -step.children[1].token->val[0];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BytecodeCompiler::isCountedStep(const SyntaxNode& statement, const Token& variable)
+{
+    if(statement.type != SyntaxNodeAssign || statement.token->str != variable.str || !isInlinable(*statement.block))
+        return false;
+
+    const SyntaxNode& step = statement.block->statements[0];
+    return step.type == SyntaxNodeOperation && step.function == nullptr && step.children.size() == 2 &&
+        (step.token->id == TokenIdAdd || step.token->id == TokenIdSubtract) &&
+        step.children[0].type == SyntaxNodeVariable && step.children[0].token->str == variable.str &&
+        step.children[1].type == SyntaxNodeLiteral && step.children[1].token->val.size() == 1;
+}
+
+bool BytecodeCompiler::getOperatorOpcode(TokenId id, Opcode& opcode)
+{
+    switch(id)
+    {
+    case TokenIdAdd: opcode = OpcodeAdd; return true;
+    case TokenIdSubtract: opcode = OpcodeSubtract; return true;
+    case TokenIdMultiply: opcode = OpcodeMultiply; return true;
+    case TokenIdDivide: opcode = OpcodeDivide; return true;
+    case TokenIdMod: opcode = OpcodeMod; return true;
+    case TokenIdPower: opcode = OpcodePower; return true;
+    case TokenIdLessThan: opcode = OpcodeLessThan; return true;
+    case TokenIdGreaterThan: opcode = OpcodeGreaterThan; return true;
+    case TokenIdLessThanOrEquals: opcode = OpcodeLessThanOrEquals; return true;
+    case TokenIdGreaterThanOrEquals: opcode = OpcodeGreaterThanOrEquals; return true;
+    case TokenIdIsEquals: opcode = OpcodeIsEquals; return true;
+    case TokenIdNotEquals: opcode = OpcodeNotEquals; return true;
+    case TokenIdUnion: opcode = OpcodeUnion; return true;
+    case TokenIdSelect: opcode = OpcodeSelect; return true;
+    case TokenIdLeftRotate: opcode = OpcodeLeftRotate; return true;
+    case TokenIdRightRotate: opcode = OpcodeRightRotate; return true;
+    case TokenIdRemove: opcode = OpcodeRemove; return true;
+    case TokenIdRemain: opcode = OpcodeRemain; return true;
+    case TokenIdCountEach: opcode = OpcodeCountEach; return true;
+    case TokenIdIterate: opcode = OpcodeIterate; return true;
+    case TokenIdLogicalNot: opcode = OpcodeLogicalNot; return true;
+    case TokenIdCount: opcode = OpcodeCount; return true;
+    case TokenIdSumAll: opcode = OpcodeSumAll; return true;
+    case TokenIdMultiplyAll: opcode = OpcodeMultiplyAll; return true;
+    case TokenIdRandom: opcode = OpcodeRandom; return true;
+    case TokenIdSine: opcode = OpcodeSine; return true;
+    case TokenIdConvert: opcode = OpcodeConvert; return true;
+    case TokenIdMakeSet: opcode = OpcodeMakeSet; return true;
+    case TokenIdCeil: opcode = OpcodeCeil; return true;
+    case TokenIdFloor: opcode = OpcodeFloor; return true;
+    case TokenIdRound: opcode = OpcodeRound; return true;
+    case TokenIdSort: opcode = OpcodeSort; return true;
+    case TokenIdReverse: opcode = OpcodeReverse; return true;
+    default: return false;
+    }
+}
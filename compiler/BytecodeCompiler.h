@@ -0,0 +1,148 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Bytecode.h"
+#include "SyntaxTree.h"
+
+// lowers syntax trees to bytecode, blocks made of a single expression are inlined,
+// runs of element wise operators whose right parameters have no side effects are fused,
+// common parenthesis found by Optimizer are calculated once per statement or once per loop,
+// loops that count a variable up or down to a limit compare and step its number in place
+class BytecodeCompiler{
+public:
+    // fusion is on by default, it applies to blocks compiled afterwards
+    static void setFusion(bool isEnabled);
+
+    // counted loops are on by default, they apply to blocks compiled afterwards
+    static void setCountedLoops(bool isEnabled);
+
+    // previous bytecode functions are replaced
+    static void compileFunctions(
+        const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+        std::unordered_map<std::string, BytecodeBlock>& bytecodeFunctions);
+
+    static void compile(
+        const SyntaxBlock& block,
+        const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+        const std::unordered_map<std::string, BytecodeBlock>& bytecodeFunctions,
+        BytecodeBlock& bytecode);
+
+private:
+    struct Context{
+        std::unordered_map<const SyntaxBlock*, const BytecodeBlock*> functions;
+    };
+
+    static Context makeContext(
+        const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+        const std::unordered_map<std::string, BytecodeBlock>& bytecodeFunctions);
+
+    static void compileBlock(const SyntaxBlock& block, const Context& context, BytecodeBlock& bytecode);
+
+    static void compileStatement(
+        const SyntaxNode& statement,
+        const SyntaxBlock& source,
+        std::vector<const SyntaxNode*>& loops,
+        const Context& context,
+        BytecodeBlock& bytecode);
+
+    // pushes the result of a block
+    static void compileValue(const SyntaxBlock& block, const Context& context, BytecodeBlock& bytecode);
+
+    // pushes the value of the expression and hands over if it is empty
+    static void compileExpression(
+        const SyntaxNode& expression,
+        const SyntaxBlock& source,
+        const std::vector<const SyntaxNode*>& loops,
+        bool isInlined,
+        const Context& context,
+        BytecodeBlock& bytecode);
+
+    static void compileNode(
+        const SyntaxNode& node,
+        const SyntaxBlock& source,
+        const std::vector<const SyntaxNode*>& loops,
+        bool isInlined,
+        const Context& context,
+        BytecodeBlock& bytecode);
+
+    static void addHandOver(
+        const SyntaxBlock& source,
+        int position,
+        const Token* operation,
+        const std::vector<const SyntaxNode*>& loops,
+        bool isInlined,
+        BytecodeBlock& bytecode);
+
+    // values of common parenthesis stored by earlier evaluations of the statement can't be reused,
+    // a parenthesis skipped by a jump leaves its slot empty and the next one calculates the value
+    static void addClearCommon(const SyntaxNode& statement, const SyntaxBlock& source, BytecodeBlock& bytecode);
+
+    static int addInstruction(BytecodeBlock& bytecode, Opcode opcode, int argument, const SyntaxBlock* source);
+
+    static bool isInlinable(const SyntaxBlock& block);
+
+    // a loop compiled with a counted condition, its variable is compared with a literal or another variable
+    // and a statement of its body assigns the variable plus or minus a literal
+    static bool getCountedLoop(const SyntaxNode& loop, CountedLoop& counted);
+
+    static bool isCountedStep(const SyntaxNode& statement, const Token& variable);
+
+    // returns false if not an operator
+    static bool getOperatorOpcode(TokenId id, Opcode& opcode);
+
+    // operators on the left of a fused run, whose result isn't stored, of a reduction and of a run without one
+    static const int MIN_REDUCED_FUSED_OPERATORS = 1;
+    static const int MIN_FUSED_OPERATORS = 2;
+
+    static bool isFusion;
+    static bool isCountedLoops;
+
+    // the node is a reduction of a run of element wise operators or a long enough run, fused collects its steps
+    static bool getFusedExpression(const SyntaxNode& node, FusedExpression& fused);
+
+    // element wise arithmetic or comparison of two parameters
+    static bool isFusibleOperation(const SyntaxNode& node);
+
+    // parenthesis whose expression is compiled inline
+    static bool isFusibleGroup(const SyntaxNode& node);
+
+    // the steps of a run, the left parameter of the innermost operation is the value on the stack,
+    // false if a right parameter may have side effects
+    static bool addFusedRun(const SyntaxNode& node, FusedExpression& fused);
+
+    // literal, variable, a, b, or parenthesis with element wise operators on them
+    static bool addFusedOperand(const SyntaxNode& node, FusedExpression& fused);
+
+    // compiles the node like compileNode, with a fused instruction after the left parameter of the innermost operation
+    static void compileFused(
+        const SyntaxNode& node,
+        std::unique_ptr<FusedExpression> fused,
+        const SyntaxBlock& source,
+        const std::vector<const SyntaxNode*>& loops,
+        bool isInlined,
+        const Context& context,
+        BytecodeBlock& bytecode);
+
+    // compileExpression and compileNode for the nodes of a fused run, fusedInstruction is set when it is added
+    static void compileFusedExpression(
+        const SyntaxNode& expression,
+        const SyntaxBlock& source,
+        const std::vector<const SyntaxNode*>& loops,
+        bool isInlined,
+        const Context& context,
+        BytecodeBlock& bytecode,
+        int& fusedInstruction);
+
+    static void compileFusedNode(
+        const SyntaxNode& node,
+        const SyntaxBlock& source,
+        const std::vector<const SyntaxNode*>& loops,
+        bool isInlined,
+        const Context& context,
+        BytecodeBlock& bytecode,
+        int& fusedInstruction);
+
+    static const int EXIT_PENDING = -2;
+};
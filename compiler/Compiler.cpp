@@ -0,0 +1,359 @@
+#include "Compiler.h"
+#include "../util/TokenSubArrayFinder.h"
+#include "../token/OperatorArguments.h"
+
+void Compiler::compileFunctions(
+    const std::unordered_map<std::string, Function>& functions,
+    std::unordered_map<std::string, SyntaxBlock>& compiledFunctions)
+{
+    // every function gets its block first so calls can point to bodies compiled later
+    compiledFunctions.clear();
+    for(const auto& function: functions)
+        compiledFunctions[function.first];
+
+    const Context context = {functions, compiledFunctions};
+    for(const auto& function: functions){
+        auto body = compileBlock(function.second.body, context);
+        compiledFunctions[function.first] = std::move(*body);
+    }
+}
+
+void Compiler::compile(
+    const TokenRange& tokens,
+    const std::unordered_map<std::string, Function>& functions,
+    const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+    SyntaxBlock& block)
+{
+    const Context context = {functions, compiledFunctions};
+    block = std::move(*compileBlock(tokens, context));
+}
+
+std::unique_ptr<SyntaxBlock> Compiler::compileBlock(const TokenRange& tokens, const Context& context)
+{
+    auto block = std::make_unique<SyntaxBlock>();
+    block->tokens = tokens;
+
+    int next;
+    block->isCompiled = compileStatements(tokens, 0, tokens.size(), false, context, block->statements, next);
+    if(!block->isCompiled)
+        block->statements.clear();
+
+    return block;
+}
+
+bool Compiler::compileStatements(
+    const TokenRange& tokens,
+    int start,
+    int end,
+    bool isLoopBody,
+    const Context& context,
+    std::vector<SyntaxNode>& statements,
+    int& next)
+{
+    // mirrors the left parameter and pending operation of the token interpreter,
+    // anything that depends on runtime values or leads to an error is not compiled
+    std::unique_ptr<SyntaxNode> chain;
+    const Token* operation = nullptr;
+
+    for(int i=start; i<end; i++){
+        const Token* token = tokens[i];
+        switch(token->id){
+            case TokenIdEndLine:
+            case TokenIdOpenCurly:
+            case TokenIdCloseCurly:
+            {
+                if(operation != nullptr)
+                    return false;
+
+                endStatement(chain, statements);
+                continue;
+            }
+            case TokenIdAsyncStart:
+            {
+                const int asyncEnd = TokenSubArrayFinder::findJumpTarget(tokens, i);
+                if(chain || operation || asyncEnd == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND || asyncEnd >= end)
+                    return false;
+
+                auto node = makeNode(SyntaxNodeAsync, token, i);
+                node->block = compileBlock(tokens.subRange(i+1, asyncEnd-1), context);
+                statements.push_back(std::move(*node));
+                i = asyncEnd;
+                continue;
+            }
+            case TokenIdAsyncJoin:
+            {
+                if(chain || operation)
+                    return false;
+
+                statements.push_back(std::move(*makeNode(SyntaxNodeJoin, token, i)));
+                continue;
+            }
+            case TokenIdIf:
+            {
+                if(chain || operation || !compileIf(tokens, i, end, context, statements))
+                    return false;
+                continue;
+            }
+            case TokenIdLoop:
+            {
+                if(chain || operation || !compileLoop(tokens, i, end, context, statements))
+                    return false;
+                continue;
+            }
+            case TokenIdWrite:
+            case TokenIdWriteText:
+            case TokenIdEquals:
+            {
+                const Token* variable = nullptr;
+                if(token->id == TokenIdEquals){
+                    // the variable was read as the left parameter, the read is replaced by the assignment
+                    if(operation || !chain || chain->type != SyntaxNodeVariable || chain->position != i-1)
+                        return false;
+                    variable = chain->token;
+                    chain.reset();
+                }else if(chain || operation){
+                    return false;
+                }
+
+                SyntaxNodeType type = token->id == TokenIdWrite ? SyntaxNodeWrite : token->id == TokenIdWriteText ? SyntaxNodeWriteText : SyntaxNodeAssign;
+                const int statementEnd = compileStatement(tokens, i, type, variable, context, statements);
+                if(statementEnd >= end){
+                    next = statementEnd + 1;
+                    return true;
+                }
+                i = statementEnd;
+                continue;
+            }
+            default:break;
+        }
+
+        std::unique_ptr<SyntaxNode> right;
+        if((!chain && token->id != TokenIdFunction && !operation) || isFunctionWithoutParameters(*token, context)){
+            if(chain || operation)
+                return false;
+
+            chain = compileArgument(tokens, i, end, context);
+            if(!chain)
+                return false;
+        }else if(!operation){
+            operation = token;
+        }else{
+            right = compileArgument(tokens, i, end, context);
+            if(!right)
+                return false;
+        }
+
+        if(!operation)
+            continue;
+
+        bool hasLeft, hasRight;
+        if(!getParameters(*operation, context, hasLeft, hasRight))
+            return false;
+
+        if(hasRight && right){
+            auto node = makeNode(SyntaxNodeOperation, operation, i);
+            node->function = findFunction(*operation, context);
+            node->children.push_back(chain ? std::move(*chain) : std::move(*makeNode(SyntaxNodeEmpty, nullptr, i)));
+            node->children.push_back(std::move(*right));
+            chain = std::move(node);
+        }else if(operation->id == TokenIdApplyToEach){
+            if(i == 0 || i+1 >= end || tokens[i+1]->id == TokenIdApplyToEach || !getParameters(*tokens[i+1], context, hasLeft, hasRight))
+                return false;
+
+            i++;
+            auto node = makeNode(SyntaxNodeApplyToEach, tokens[i], i);
+            node->function = findFunction(*tokens[i], context);
+            node->children.push_back(std::move(*chain));
+            chain = std::move(node);
+        }else if(hasLeft && chain && !hasRight){
+            auto node = makeNode(SyntaxNodeOperation, operation, i);
+            node->function = findFunction(*operation, context);
+            node->children.push_back(std::move(*chain));
+            chain = std::move(node);
+        }else{
+            if(right)
+                return false;
+            continue;
+        }
+        operation = nullptr;
+    }
+
+    // a loop body continues with its left parameter in the next iteration
+    if(operation || (isLoopBody && chain))
+        return false;
+
+    endStatement(chain, statements);
+    next = end;
+    return true;
+}
+
+bool Compiler::compileIf(
+    const TokenRange& tokens,
+    int& position,
+    int end,
+    const Context& context,
+    std::vector<SyntaxNode>& statements)
+{
+    const int bodyStart = TokenSubArrayFinder::findJumpTarget(tokens, position);
+    if(bodyStart == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND || bodyStart >= end)
+        return false;
+    const int bodyEnd = TokenSubArrayFinder::findJumpTarget(tokens, bodyStart);
+    if(bodyEnd == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND || bodyEnd >= end)
+        return false;
+
+    auto node = makeNode(SyntaxNodeIf, tokens[position], position);
+    node->block = compileBlock(tokens.subRange(position+1, bodyStart-1), context);
+    int next;
+    if(!compileStatements(tokens, bodyStart+1, bodyEnd, false, context, node->children, next))
+        return false;
+
+    // a statement ending on the last line of the body also takes '}' and the end of the line,
+    // the skipped branch continues from the same place if nothing else is on that line
+    if(next == bodyEnd || next == bodyEnd + 1){
+        position = bodyEnd;
+    }else if(next == bodyEnd + 2 && tokens[bodyEnd+1]->id == TokenIdEndLine){
+        position = bodyEnd + 1;
+    }else{
+        return false;
+    }
+
+    statements.push_back(std::move(*node));
+    return true;
+}
+
+bool Compiler::compileLoop(
+    const TokenRange& tokens,
+    int& position,
+    int end,
+    const Context& context,
+    std::vector<SyntaxNode>& statements)
+{
+    const int bodyStart = TokenSubArrayFinder::findJumpTarget(tokens, position);
+    if(bodyStart == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND || bodyStart >= end)
+        return false;
+    const int bodyEnd = TokenSubArrayFinder::findJumpTarget(tokens, bodyStart);
+    if(bodyEnd == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND || bodyEnd >= end)
+        return false;
+
+    auto node = makeNode(SyntaxNodeLoop, tokens[position], bodyStart);
+    node->endPosition = bodyEnd;
+    node->block = compileBlock(tokens.subRange(position+1, bodyStart-1), context);
+    int next;
+    if(!compileStatements(tokens, bodyStart+1, bodyEnd, true, context, node->children, next) || next != bodyEnd)
+        return false;
+
+    statements.push_back(std::move(*node));
+    position = bodyEnd;
+    return true;
+}
+
+int Compiler::compileStatement(
+    const TokenRange& tokens,
+    int position,
+    SyntaxNodeType type,
+    const Token* variable,
+    const Context& context,
+    std::vector<SyntaxNode>& statements)
+{
+    const int statementEnd = TokenSubArrayFinder::findJumpTarget(tokens, position);
+    auto node = makeNode(type, variable, position);
+    node->block = compileBlock(tokens.subRange(position+1, statementEnd), context);
+    statements.push_back(std::move(*node));
+
+    return statementEnd;
+}
+
+std::unique_ptr<SyntaxNode> Compiler::compileArgument(
+    const TokenRange& tokens,
+    int& position,
+    int end,
+    const Context& context)
+{
+    const Token* token = tokens[position];
+    switch(token->id)
+    {
+    case TokenIdVariable:
+        return makeNode(SyntaxNodeVariable, token, position);
+    case TokenIdLiteral:
+        return makeNode(SyntaxNodeLiteral, token, position);
+    case TokenIdLeftParam:
+        return makeNode(SyntaxNodeLeftParam, token, position);
+    case TokenIdRightParam:
+        return makeNode(SyntaxNodeRightParam, token, position);
+    case TokenIdRead:
+        return makeNode(SyntaxNodeRead, token, position);
+    case TokenIdReadText:
+        return makeNode(SyntaxNodeReadText, token, position);
+    case TokenIdFunction:
+    {
+        if(!isFunctionWithoutParameters(*token, context))
+            return nullptr;
+
+        auto node = makeNode(SyntaxNodeCall, token, position);
+        node->function = findFunction(*token, context);
+        return node;
+    }
+    case TokenIdOpenParenthesis:
+    {
+        const int endPosition = TokenSubArrayFinder::findJumpTarget(tokens, position);
+        if(endPosition == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND || endPosition >= end)
+            return nullptr;
+
+        auto node = makeNode(SyntaxNodeGroup, token, endPosition);
+        node->block = compileBlock(tokens.subRange(position+1, endPosition-1), context);
+        position = endPosition;
+        return node;
+    }
+    default:
+        return nullptr;
+    }
+}
+
+std::unique_ptr<SyntaxNode> Compiler::makeNode(SyntaxNodeType type, const Token* token, int position)
+{
+    auto node = std::make_unique<SyntaxNode>();
+    node->type = type;
+    node->token = token;
+    node->position = position;
+    return node;
+}
+
+void Compiler::endStatement(std::unique_ptr<SyntaxNode>& chain, std::vector<SyntaxNode>& statements)
+{
+    if(chain){
+        statements.push_back(std::move(*chain));
+        chain.reset();
+    }
+}
+
+bool Compiler::getParameters(const Token& operation, const Context& context, bool& hasLeft, bool& hasRight)
+{
+    if(operation.id != TokenIdFunction)
+        return OperatorArguments::getArgs(operation.id, hasLeft, hasRight);
+
+    const auto function = context.functions.find(operation.str);
+    if(function == context.functions.end())
+        return false;
+
+    hasLeft = function->second.hasLeft;
+    hasRight = function->second.hasRight;
+    return true;
+}
+
+bool Compiler::isFunctionWithoutParameters(const Token& token, const Context& context)
+{
+    bool hasLeft, hasRight;
+    if(token.id != TokenIdFunction || !getParameters(token, context, hasLeft, hasRight))
+        return false;
+
+    return (!hasLeft) && (!hasRight);
+}
+
+const SyntaxBlock* Compiler::findFunction(const Token& token, const Context& context)
+{
+    if(token.id != TokenIdFunction)
+        return nullptr;
+
+    const auto function = context.compiledFunctions.find(token.str);
+    return function == context.compiledFunctions.end() ? nullptr : &function->second;
+}
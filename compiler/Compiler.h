@@ -0,0 +1,84 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SyntaxTree.h"
+#include "../scanner/Function.h"
+#include "../token/TokenRange.h"
+
+// turns token arrays into syntax trees with resolved operations, arities and called functions
+// blocks whose evaluation order depends on runtime values are left to the token interpreter
+class Compiler{
+public:
+    // compiles every function body, previous compiled bodies are replaced
+    static void compileFunctions(
+        const std::unordered_map<std::string, Function>& functions,
+        std::unordered_map<std::string, SyntaxBlock>& compiledFunctions);
+
+    static void compile(
+        const TokenRange& tokens,
+        const std::unordered_map<std::string, Function>& functions,
+        const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions,
+        SyntaxBlock& block);
+
+private:
+    struct Context{
+        const std::unordered_map<std::string, Function>& functions;
+        const std::unordered_map<std::string, SyntaxBlock>& compiledFunctions;
+    };
+
+    static std::unique_ptr<SyntaxBlock> compileBlock(const TokenRange& tokens, const Context& context);
+
+    // compiles tokens from start to end, next is set past the last compiled token,
+    // it is after end if the last statement continues past end
+    // returns false if the tokens can't be compiled
+    static bool compileStatements(
+        const TokenRange& tokens,
+        int start,
+        int end,
+        bool isLoopBody,
+        const Context& context,
+        std::vector<SyntaxNode>& statements,
+        int& next);
+
+    static bool compileIf(
+        const TokenRange& tokens,
+        int& position,
+        int end,
+        const Context& context,
+        std::vector<SyntaxNode>& statements);
+
+    static bool compileLoop(
+        const TokenRange& tokens,
+        int& position,
+        int end,
+        const Context& context,
+        std::vector<SyntaxNode>& statements);
+
+    // compiles '=', 'w' and 't' statements, returns the statement end position
+    static int compileStatement(
+        const TokenRange& tokens,
+        int position,
+        SyntaxNodeType type,
+        const Token* variable,
+        const Context& context,
+        std::vector<SyntaxNode>& statements);
+
+    static std::unique_ptr<SyntaxNode> compileArgument(
+        const TokenRange& tokens,
+        int& position,
+        int end,
+        const Context& context);
+
+    static std::unique_ptr<SyntaxNode> makeNode(SyntaxNodeType type, const Token* token, int position);
+
+    static void endStatement(std::unique_ptr<SyntaxNode>& chain, std::vector<SyntaxNode>& statements);
+
+    // returns false if not an operation
+    static bool getParameters(const Token& operation, const Context& context, bool& hasLeft, bool& hasRight);
+
+    static bool isFunctionWithoutParameters(const Token& token, const Context& context);
+
+    static const SyntaxBlock* findFunction(const Token& token, const Context& context);
+};
@@ -0,0 +1,411 @@
+#include "Optimizer.h"
+#include "../interpreter/InterpreterCalculator.h"
+
+bool Optimizer::isOptimization = true;
+
+void Optimizer::setOptimization(bool isEnabled)
+{
+    isOptimization = isEnabled;
+}
+
+void Optimizer::optimizeFunctions(std::unordered_map<std::string, SyntaxBlock>& compiledFunctions)
+{
+    for(auto& function: compiledFunctions)
+        optimize(function.second);
+}
+
+void Optimizer::optimize(SyntaxBlock& block)
+{
+    if(!isOptimization)
+        return;
+
+    foldBlock(block);
+    findCommonInBlock(block);
+}
+
+void Optimizer::foldBlock(SyntaxBlock& block)
+{
+    if(!block.isCompiled)
+        return;
+
+    for(auto& statement: block.statements)
+        fold(statement, block);
+}
+
+void Optimizer::fold(SyntaxNode& node, SyntaxBlock& block)
+{
+    for(auto& child: node.children)
+        fold(child, block);
+    if(node.block)
+        foldBlock(*node.block);
+
+    if(node.type == SyntaxNodeGroup){
+        SyntaxBlock& group = *node.block;
+        if(!isInlined(group) || group.statements[0].type != SyntaxNodeLiteral)
+            return;
+
+        // the literal may be owned by the parenthesis, which is removed
+        for(auto& constant: group.constants)
+            block.constants.push_back(std::move(constant));
+        replaceWithLiteral(node, group.statements[0].token);
+        return;
+    }
+
+    Value value;
+    if(node.type != SyntaxNodeOperation || !calculateConstant(node, value))
+        return;
+
+    auto literal = std::make_unique<Token>();
+    literal->str = getKey(node);
+    literal->val = std::move(value);
+    literal->id = TokenIdLiteral;
+    replaceWithLiteral(node, literal.get());
+    block.constants.push_back(std::move(literal));
+}
+
+bool Optimizer::calculateConstant(const SyntaxNode& node, Value& value)
+{
+    const TokenId id = node.token->id;
+    if(node.function != nullptr || id == TokenIdFunction || id == TokenIdRandom)
+        return false;
+
+    const SyntaxNode& left = node.children[0];
+    const bool hasRight = node.children.size() > 1;
+    if((left.type != SyntaxNodeLiteral && left.type != SyntaxNodeEmpty) || (hasRight && node.children[1].type != SyntaxNodeLiteral))
+        return false;
+
+    const Value empty;
+    const Value& leftValue = left.type == SyntaxNodeLiteral ? left.token->val : empty;
+    const Value& rightValue = hasRight ? node.children[1].token->val : empty;
+    if(leftValue.size() > MAX_FOLDED_SIZE || rightValue.size() > MAX_FOLDED_SIZE)
+        return false;
+
+    // errors are left to be reported when the operator runs, an empty value hands over to the token interpreter
+    bool hadError = false;
+    if(!InterpreterCalculator::calculate(id, leftValue, rightValue, value, hadError, nullptr) || hadError)
+        return false;
+
+    return value.size() != 0 && value.size() <= MAX_FOLDED_SIZE;
+}
+
+void Optimizer::replaceWithLiteral(SyntaxNode& node, const Token* literal)
+{
+    // the position stays on the last token, the token interpreter continues after it
+    node.type = SyntaxNodeLiteral;
+    node.token = literal;
+    node.function = nullptr;
+    node.block.reset();
+    node.children.clear();
+}
+
+void Optimizer::findCommonInStatements(std::vector<SyntaxNode>& statements, SyntaxBlock& block)
+{
+    for(auto& statement: statements){
+        switch(statement.type){
+            case SyntaxNodeAssign:
+            case SyntaxNodeWrite:
+            case SyntaxNodeWriteText:
+            case SyntaxNodeIf:
+            case SyntaxNodeLoop:
+            {
+                // parenthesis invariant in an outer loop are already taken
+                if(statement.type == SyntaxNodeLoop)
+                    findInvariants(statement, block);
+
+                if(isInlined(*statement.block))
+                    findCommon(statement, statement.block->statements[0], block);
+                else
+                    findCommonInBlock(*statement.block);
+
+                findCommonInStatements(statement.children, block);
+                break;
+            }
+            case SyntaxNodeAsync:
+                findCommonInBlock(*statement.block);
+                break;
+            case SyntaxNodeJoin:
+                break;
+            default:
+                findCommon(statement, statement, block);
+                break;
+        }
+    }
+}
+
+void Optimizer::findCommonInBlock(SyntaxBlock& block)
+{
+    if(block.isCompiled)
+        findCommonInStatements(block.statements, block);
+}
+
+void Optimizer::findCommon(SyntaxNode& statement, SyntaxNode& expression, SyntaxBlock& block)
+{
+    std::vector<SyntaxNode*> groups;
+    std::vector<size_t> ends;
+    std::vector<SyntaxBlock*> blocks;
+    collectGroups(expression, groups, ends, blocks);
+    for(const auto nested: blocks)
+        findCommonInBlock(*nested);
+    const bool mayWrite = mayWriteVariables(expression);
+
+    // the first parenthesis with each key, it gets a slot when the key is repeated
+    std::unordered_map<std::string, SyntaxNode*> first;
+    statement.firstCommon = block.commonValues;
+    for(size_t i=0; i<groups.size(); i++){
+        SyntaxNode* group = groups[i];
+        // the parenthesis in a reused one aren't evaluated
+        if(group->common != SyntaxNode::NOT_COMMON){
+            i = ends[i] - 1;
+            continue;
+        }
+
+        std::unordered_set<std::string> variables;
+        const SyntaxNode& value = group->block->statements[0];
+        if(value.type != SyntaxNodeOperation || !isPure(value, variables) || (!variables.empty() && mayWrite))
+            continue;
+
+        const std::string key = getKey(*group);
+        const auto found = first.find(key);
+        if(found == first.end()){
+            first[key] = group;
+            continue;
+        }
+
+        if(found->second->common == SyntaxNode::NOT_COMMON)
+            found->second->common = block.commonValues++;
+        group->common = found->second->common;
+        i = ends[i] - 1;
+    }
+    statement.commonValues = block.commonValues - statement.firstCommon;
+}
+
+void Optimizer::findInvariants(SyntaxNode& loop, SyntaxBlock& block)
+{
+    std::unordered_set<std::string> written;
+    std::unordered_set<const SyntaxBlock*> visited;
+    const bool areWritesKnown = collectWrites(loop, written, visited);
+
+    // parenthesis in blocks that aren't inlined are evaluated by bytecode blocks of their own
+    std::vector<SyntaxNode*> groups;
+    std::vector<size_t> ends;
+    std::vector<SyntaxBlock*> blocks;
+    if(isInlined(*loop.block))
+        collectGroups(loop.block->statements[0], groups, ends, blocks);
+    collectGroupsInStatements(loop.children, groups, ends, blocks);
+
+    std::unordered_map<std::string, int> slots;
+    loop.firstInvariant = block.commonValues;
+    for(size_t i=0; i<groups.size(); i++){
+        SyntaxNode* group = groups[i];
+        if(group->common != SyntaxNode::NOT_COMMON){
+            i = ends[i] - 1;
+            continue;
+        }
+
+        std::unordered_set<std::string> variables;
+        const SyntaxNode& value = group->block->statements[0];
+        if(value.type != SyntaxNodeOperation || !isPure(value, variables) || (!variables.empty() && !areWritesKnown))
+            continue;
+
+        bool isInvariant = true;
+        for(const auto& variable: variables)
+            isInvariant = isInvariant && written.count(variable) == 0;
+        if(!isInvariant)
+            continue;
+
+        const std::string key = getKey(*group);
+        const auto found = slots.find(key);
+        group->common = found == slots.end() ? (slots[key] = block.commonValues++) : found->second;
+        group->isInvariant = true;
+        i = ends[i] - 1;
+    }
+    loop.invariantValues = block.commonValues - loop.firstInvariant;
+}
+
+void Optimizer::collectGroups(
+    SyntaxNode& node,
+    std::vector<SyntaxNode*>& groups,
+    std::vector<size_t>& ends,
+    std::vector<SyntaxBlock*>& blocks)
+{
+    if(node.type != SyntaxNodeGroup){
+        for(auto& child: node.children)
+            collectGroups(child, groups, ends, blocks);
+        return;
+    }
+
+    if(!isInlined(*node.block)){
+        blocks.push_back(node.block.get());
+        return;
+    }
+
+    const size_t index = groups.size();
+    groups.push_back(&node);
+    ends.push_back(0);
+    collectGroups(node.block->statements[0], groups, ends, blocks);
+    ends[index] = groups.size();
+}
+
+void Optimizer::collectGroupsInStatements(
+    std::vector<SyntaxNode>& statements,
+    std::vector<SyntaxNode*>& groups,
+    std::vector<size_t>& ends,
+    std::vector<SyntaxBlock*>& blocks)
+{
+    for(auto& statement: statements){
+        switch(statement.type){
+            case SyntaxNodeAssign:
+            case SyntaxNodeWrite:
+            case SyntaxNodeWriteText:
+            case SyntaxNodeIf:
+            case SyntaxNodeLoop:
+            {
+                if(isInlined(*statement.block))
+                    collectGroups(statement.block->statements[0], groups, ends, blocks);
+                collectGroupsInStatements(statement.children, groups, ends, blocks);
+                break;
+            }
+            case SyntaxNodeAsync:
+            case SyntaxNodeJoin:
+                break;
+            default:
+                collectGroups(statement, groups, ends, blocks);
+                break;
+        }
+    }
+}
+
+bool Optimizer::isPure(const SyntaxNode& node, std::unordered_set<std::string>& variables)
+{
+    switch(node.type)
+    {
+    case SyntaxNodeLiteral:
+    case SyntaxNodeLeftParam:
+    case SyntaxNodeRightParam:
+    case SyntaxNodeEmpty:
+        return true;
+    case SyntaxNodeVariable:
+        variables.insert(node.token->str);
+        return true;
+    case SyntaxNodeGroup:
+        return isInlined(*node.block) && isPure(node.block->statements[0], variables);
+    case SyntaxNodeOperation:
+    {
+        if(node.token->id == TokenIdFunction || node.token->id == TokenIdRandom)
+            return false;
+
+        for(const auto& child: node.children){
+            if(!isPure(child, variables))
+                return false;
+        }
+        return true;
+    }
+    default:
+        // apply to each reports errors and continues, each evaluation reports them
+        return false;
+    }
+}
+
+bool Optimizer::mayWriteVariables(const SyntaxNode& node)
+{
+    switch(node.type)
+    {
+    case SyntaxNodeAssign:
+    case SyntaxNodeAsync:
+    case SyntaxNodeCall:
+        return true;
+    case SyntaxNodeOperation:
+    case SyntaxNodeApplyToEach:
+        if(node.token->id == TokenIdFunction)
+            return true;
+        break;
+    default:
+        break;
+    }
+
+    if(node.block){
+        if(!node.block->isCompiled)
+            return true;
+        for(const auto& statement: node.block->statements){
+            if(mayWriteVariables(statement))
+                return true;
+        }
+    }
+    for(const auto& child: node.children){
+        if(mayWriteVariables(child))
+            return true;
+    }
+    return false;
+}
+
+bool Optimizer::collectWrites(
+    const SyntaxNode& node,
+    std::unordered_set<std::string>& written,
+    std::unordered_set<const SyntaxBlock*>& visited)
+{
+    switch(node.type)
+    {
+    case SyntaxNodeAssign:
+        written.insert(node.token->str);
+        break;
+    case SyntaxNodeAsync:
+        return false;
+    case SyntaxNodeCall:
+    case SyntaxNodeOperation:
+    case SyntaxNodeApplyToEach:
+        if(node.token->id == TokenIdFunction && node.function == nullptr)
+            return false;
+        break;
+    default:
+        break;
+    }
+
+    // a called function is searched once
+    if(node.function != nullptr && visited.insert(node.function).second){
+        if(!node.function->isCompiled)
+            return false;
+        for(const auto& statement: node.function->statements){
+            if(!collectWrites(statement, written, visited))
+                return false;
+        }
+    }
+    if(node.block){
+        if(!node.block->isCompiled)
+            return false;
+        for(const auto& statement: node.block->statements){
+            if(!collectWrites(statement, written, visited))
+                return false;
+        }
+    }
+    for(const auto& child: node.children){
+        if(!collectWrites(child, written, visited))
+            return false;
+    }
+    return true;
+}
+
+bool Optimizer::isInlined(const SyntaxBlock& block)
+{
+    return block.isCompiled && block.statements.size() == 1 && block.statements[0].type < SyntaxNodeAssign;
+}
+
+std::string Optimizer::getKey(const SyntaxNode& node)
+{
+    switch(node.type)
+    {
+    case SyntaxNodeGroup:
+        return "(" + getKey(node.block->statements[0]) + ")";
+    case SyntaxNodeOperation:
+    {
+        // operations chain to the left, only parenthesis change the order
+        std::string key = getKey(node.children[0]) + ' ' + node.token->str;
+        if(node.children.size() > 1)
+            key += ' ' + getKey(node.children[1]);
+        return key;
+    }
+    case SyntaxNodeEmpty:
+        return "";
+    default:
+        return node.token->str;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "SyntaxTree.h"
+
+// rewrites compiled syntax trees, operators on literals are folded into literals, parenthesis that are
+// evaluated more than once in a statement or in every iteration of a loop with the same value get a slot their
+// value is reused from, blocks left to the token interpreter are unchanged
+class Optimizer{
+public:
+    // optimization is on by default, it applies to blocks optimized afterwards
+    static void setOptimization(bool isEnabled);
+
+    static void optimizeFunctions(std::unordered_map<std::string, SyntaxBlock>& compiledFunctions);
+
+    static void optimize(SyntaxBlock& block);
+
+private:
+    // elements of the parameters and result of a folded operator, larger constants are calculated when they are used
+    static const size_t MAX_FOLDED_SIZE = 4096;
+
+    static bool isOptimization;
+
+    static void foldBlock(SyntaxBlock& block);
+
+    // folds the operands of the node before the node, the literals are owned by block
+    static void fold(SyntaxNode& node, SyntaxBlock& block);
+
+    // the value of an operator on literals, false if it reports an error, is empty, random or too large
+    static bool calculateConstant(const SyntaxNode& node, Value& value);
+
+    static void replaceWithLiteral(SyntaxNode& node, const Token* literal);
+
+    // finds the common parenthesis of the statements, their slots are in the bytecode block compiled from block
+    static void findCommonInStatements(std::vector<SyntaxNode>& statements, SyntaxBlock& block);
+
+    static void findCommonInBlock(SyntaxBlock& block);
+
+    // numbers the parenthesis of the expression of a statement that are repeated, their value is the same each time
+    // if they only read a, b and literals or if nothing in the expression can write variables
+    static void findCommon(SyntaxNode& statement, SyntaxNode& expression, SyntaxBlock& block);
+
+    // numbers the parenthesis in the condition and body of a loop whose value is the same in every iteration,
+    // they read a, b, literals and variables that the loop and the functions it calls don't assign
+    static void findInvariants(SyntaxNode& loop, SyntaxBlock& block);
+
+    // parenthesis of the expression, and of parenthesis compiled inline with it, in the order they are evaluated,
+    // ends are the indexes past the parenthesis nested in each one, blocks are the parenthesis that aren't inlined
+    static void collectGroups(
+        SyntaxNode& node,
+        std::vector<SyntaxNode*>& groups,
+        std::vector<size_t>& ends,
+        std::vector<SyntaxBlock*>& blocks);
+
+    // collectGroups for the values of statements in the same bytecode block
+    static void collectGroupsInStatements(
+        std::vector<SyntaxNode>& statements,
+        std::vector<SyntaxNode*>& groups,
+        std::vector<size_t>& ends,
+        std::vector<SyntaxBlock*>& blocks);
+
+    // literals, variables, a, b and operators other than '?' on them, variables are the names read
+    static bool isPure(const SyntaxNode& node, std::unordered_set<std::string>& variables);
+
+    // assignments, async blocks, function calls and blocks left to the token interpreter
+    static bool mayWriteVariables(const SyntaxNode& node);
+
+    // names of the variables the node and the functions it calls assign, false if they can't be known
+    // because of async blocks or blocks left to the token interpreter
+    static bool collectWrites(
+        const SyntaxNode& node,
+        std::unordered_set<std::string>& written,
+        std::unordered_set<const SyntaxBlock*>& visited);
+
+    // the value of a block with one expression is the value of the expression
+    static bool isInlined(const SyntaxBlock& block);
+
+    // source text of a pure expression, equal for expressions with the same value
+    static std::string getKey(const SyntaxNode& node);
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "../token/Token.h"
+#include "../token/TokenRange.h"
+
+enum SyntaxNodeType{
+    // expressions
+    SyntaxNodeLiteral,
+    SyntaxNodeVariable,
+    SyntaxNodeLeftParam,
+    SyntaxNodeRightParam,
+    SyntaxNodeRead,
+    SyntaxNodeReadText,
+    SyntaxNodeGroup,
+    SyntaxNodeCall,
+    SyntaxNodeEmpty,
+    SyntaxNodeOperation,
+    SyntaxNodeApplyToEach,
+    // statements
+    SyntaxNodeAssign,
+    SyntaxNodeWrite,
+    SyntaxNodeWriteText,
+    SyntaxNodeIf,
+    SyntaxNodeLoop,
+    SyntaxNodeAsync,
+    SyntaxNodeJoin
+};
+
+struct SyntaxBlock;
+class MemoCache;
+
+struct SyntaxNode{
+    SyntaxNodeType type;
+    // literal, variable, operator or function token
+    const Token* token = nullptr;
+    // position of the last token of the node in the tokens of its block
+    int position = 0;
+    // position of '}' of a loop body
+    int endPosition = 0;
+    // compiled body of a called function
+    const SyntaxBlock* function = nullptr;
+    // parenthesis, condition, statement or async block
+    std::unique_ptr<SyntaxBlock> block;
+    // operands of an operation, statements of if and loop bodies
+    std::vector<SyntaxNode> children;
+    // slot of a parenthesis whose value is reused by the bytecode engine within its statement, set by Optimizer
+    int common = NOT_COMMON;
+    // the value of the parenthesis is reused in every iteration of a loop
+    bool isInvariant = false;
+    // slots of the common parenthesis of an expression statement or of the value of a statement,
+    // they are emptied each time the statement starts
+    int firstCommon = 0;
+    int commonValues = 0;
+    // slots of the invariant parenthesis of a loop, they are emptied when the loop starts
+    int firstInvariant = 0;
+    int invariantValues = 0;
+
+    static const int NOT_COMMON = -1;
+};
+
+// tokens executed with their own left parameter and last result
+struct SyntaxBlock{
+    TokenRange tokens;
+    // false if the block is left to the token interpreter
+    bool isCompiled = false;
+    std::vector<SyntaxNode> statements;
+    // literals that constant subexpressions were folded into
+    std::vector<std::unique_ptr<Token>> constants;
+    // slots of common parenthesis in the bytecode block of the block
+    int commonValues = 0;
+    // results of a memoized function, set by the interpreter
+    MemoCache* memoCache = nullptr;
+};
@@ -0,0 +1,289 @@
+#include "ArrayKernels.h"
+#include <algorithm>
+#include <cmath>
+
+// every kernel is cloned per instruction set and the loops it inlines are vectorized for each clone,
+// the clone is resolved once when the program loads, so the binary doesn't depend on the build machine
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && (!defined(__clang__) || __clang_major__ >= 14)
+#define ARRAY_KERNEL_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define ARRAY_KERNEL_CLONES
+#endif
+
+#if defined(__GNUC__)
+#define ARRAY_KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define ARRAY_KERNEL_INLINE inline
+#endif
+
+namespace{
+
+// a lane per double of an AVX-512 register
+const size_t LANES = 8;
+
+struct Add{ static double apply(double a, double b){ return a + b; } };
+struct Subtract{ static double apply(double a, double b){ return a - b; } };
+struct Multiply{ static double apply(double a, double b){ return a * b; } };
+struct Divide{ static double apply(double a, double b){ return a / b; } };
+struct Mod{ static double apply(double a, double b){ return (double)((long long)a % (long long)b); } };
+struct Power{ static double apply(double a, double b){ return pow(a, b); } };
+
+struct LessThan{ static bool apply(double a, double b){ return a < b; } };
+struct GreaterThan{ static bool apply(double a, double b){ return a > b; } };
+struct LessThanOrEquals{ static bool apply(double a, double b){ return a <= b; } };
+struct GreaterThanOrEquals{ static bool apply(double a, double b){ return a >= b; } };
+struct Equals{ static bool apply(double a, double b){ return a == b; } };
+struct NotEquals{ static bool apply(double a, double b){ return a != b; } };
+
+template<typename Operation, typename Output>
+ARRAY_KERNEL_INLINE void broadcast(const double* left, size_t leftSize, const double* right, size_t rightSize, Output* result, size_t size)
+{
+    if(leftSize == size && rightSize == size){
+        for(size_t i=0; i<size; i++)
+            result[i] = Operation::apply(left[i], right[i]);
+    }else if(leftSize == 1){
+        const double scalar = left[0];
+        for(size_t i=0; i<size; i++)
+            result[i] = Operation::apply(scalar, right[i]);
+    }else if(rightSize == 1){
+        const double scalar = right[0];
+        for(size_t i=0; i<size; i++)
+            result[i] = Operation::apply(left[i], scalar);
+    }else{
+        // contiguous runs up to the next end of a parameter
+        size_t leftPosition = 0;
+        size_t rightPosition = 0;
+        for(size_t i=0; i<size;){
+            const size_t run = std::min(std::min(leftSize - leftPosition, rightSize - rightPosition), size - i);
+            for(size_t j=0; j<run; j++)
+                result[i + j] = Operation::apply(left[leftPosition + j], right[rightPosition + j]);
+
+            i += run;
+            leftPosition = leftPosition + run == leftSize ? 0 : leftPosition + run;
+            rightPosition = rightPosition + run == rightSize ? 0 : rightPosition + run;
+        }
+    }
+}
+
+}
+
+ARRAY_KERNEL_CLONES
+void ArrayKernels::calculate(
+    ArrayOperation operation,
+    const double* left,
+    size_t leftSize,
+    const double* right,
+    size_t rightSize,
+    double* result,
+    size_t size)
+{
+    switch(operation)
+    {
+    case ArrayOperationAdd:
+        broadcast<Add>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayOperationSubtract:
+        broadcast<Subtract>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayOperationMultiply:
+        broadcast<Multiply>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayOperationDivide:
+        broadcast<Divide>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayOperationMod:
+        broadcast<Mod>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayOperationPower:
+        broadcast<Power>(left, leftSize, right, rightSize, result, size);
+        return;
+    }
+}
+
+ARRAY_KERNEL_CLONES
+void ArrayKernels::compare(
+    ArrayComparison comparison,
+    const double* left,
+    size_t leftSize,
+    const double* right,
+    size_t rightSize,
+    unsigned char* result,
+    size_t size)
+{
+    switch(comparison)
+    {
+    case ArrayComparisonLessThan:
+        broadcast<LessThan>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonGreaterThan:
+        broadcast<GreaterThan>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonLessThanOrEquals:
+        broadcast<LessThanOrEquals>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonGreaterThanOrEquals:
+        broadcast<GreaterThanOrEquals>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonEquals:
+        broadcast<Equals>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonNotEquals:
+        broadcast<NotEquals>(left, leftSize, right, rightSize, result, size);
+        return;
+    }
+}
+
+ARRAY_KERNEL_CLONES
+void ArrayKernels::compare(
+    ArrayComparison comparison,
+    const double* left,
+    size_t leftSize,
+    const double* right,
+    size_t rightSize,
+    double* result,
+    size_t size)
+{
+    switch(comparison)
+    {
+    case ArrayComparisonLessThan:
+        broadcast<LessThan>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonGreaterThan:
+        broadcast<GreaterThan>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonLessThanOrEquals:
+        broadcast<LessThanOrEquals>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonGreaterThanOrEquals:
+        broadcast<GreaterThanOrEquals>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonEquals:
+        broadcast<Equals>(left, leftSize, right, rightSize, result, size);
+        return;
+    case ArrayComparisonNotEquals:
+        broadcast<NotEquals>(left, leftSize, right, rightSize, result, size);
+        return;
+    }
+}
+
+ARRAY_KERNEL_CLONES
+bool ArrayKernels::hasZero(const double* numbers, size_t size, bool isTruncated)
+{
+    // no early exit, so the whole scan is vectorized
+    bool found = false;
+    if(isTruncated){
+        for(size_t i=0; i<size; i++)
+            found |= numbers[i] > -1.0 && numbers[i] < 1.0;
+    }else{
+        for(size_t i=0; i<size; i++)
+            found |= numbers[i] == 0.0;
+    }
+    return found;
+}
+
+ARRAY_KERNEL_CLONES
+bool ArrayKernels::hasNaN(const double* numbers, size_t size)
+{
+    bool found = false;
+    for(size_t i=0; i<size; i++)
+        found |= numbers[i] != numbers[i];
+    return found;
+}
+
+double ArrayKernels::sum(const double* numbers, size_t size, double sum)
+{
+    for(size_t i=0; i<size; i++)
+        sum += numbers[i];
+    return sum;
+}
+
+ARRAY_KERNEL_CLONES
+double ArrayKernels::sumInLanes(const double* numbers, size_t size)
+{
+    double lanes[LANES] = {};
+    size_t i = 0;
+    for(; i + LANES <= size; i += LANES){
+        for(size_t j=0; j<LANES; j++)
+            lanes[j] += numbers[i + j];
+    }
+
+    double sum = 0.0;
+    for(size_t j=0; j<LANES; j++)
+        sum += lanes[j];
+    for(; i<size; i++)
+        sum += numbers[i];
+    return sum;
+}
+
+double ArrayKernels::compensatedSum(const double* numbers, size_t size, double& sum, double& compensation)
+{
+    for(size_t i=0; i<size; i++){
+        const double number = numbers[i];
+        const double next = sum + number;
+        // the lost low order bits of the smaller addend, inf - inf would make them NaN once the sum overflows
+        if(std::isfinite(next))
+            compensation += std::abs(sum) >= std::abs(number) ? (sum - next) + number : (number - next) + sum;
+        sum = next;
+    }
+    return std::isfinite(sum) ? sum + compensation : sum;
+}
+
+ARRAY_KERNEL_CLONES
+double ArrayKernels::compensatedSumInLanes(const double* numbers, size_t size)
+{
+    double lanes[LANES] = {};
+    double compensations[LANES] = {};
+    size_t i = 0;
+    for(; i + LANES <= size; i += LANES){
+        for(size_t j=0; j<LANES; j++){
+            const double number = numbers[i + j];
+            const double sum = lanes[j] + number;
+            const double lost = std::abs(lanes[j]) >= std::abs(number) ? (lanes[j] - sum) + number : (number - sum) + lanes[j];
+            compensations[j] += std::isfinite(sum) ? lost : 0.0;
+            lanes[j] = sum;
+        }
+    }
+
+    double sum = 0.0;
+    double compensation = 0.0;
+    for(size_t j=0; j<LANES; j++){
+        compensatedSum(lanes + j, 1, sum, compensation);
+        compensatedSum(compensations + j, 1, sum, compensation);
+    }
+    return compensatedSum(numbers + i, size - i, sum, compensation);
+}
+
+double ArrayKernels::product(const double* numbers, size_t size, double product)
+{
+    for(size_t i=0; i<size; i++)
+        product *= numbers[i];
+    return product;
+}
+
+double ArrayKernels::product(const double* numbers, size_t size, double& smallest, double& largest)
+{
+    double product = 1.0;
+    smallest = 1.0;
+    largest = 1.0;
+    for(size_t i=0; i<size; i++){
+        product *= numbers[i];
+        // a NaN product leaves them as they are, the product stays NaN to the end
+        smallest = std::min(smallest, std::abs(product));
+        largest = std::max(largest, std::abs(product));
+    }
+    return product;
+}
+
+ARRAY_KERNEL_CLONES
+long long ArrayKernels::sumBytes(const unsigned char* bytes, size_t size, bool isCharacter)
+{
+    long long sum = 0;
+    if(isCharacter){
+        for(size_t i=0; i<size; i++)
+            sum += (signed char)bytes[i];
+    }else{
+        for(size_t i=0; i<size; i++)
+            sum += bytes[i];
+    }
+    return sum;
+}
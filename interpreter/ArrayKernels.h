@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+
+enum ArrayOperation{
+    ArrayOperationAdd,
+    ArrayOperationSubtract,
+    ArrayOperationMultiply,
+    ArrayOperationDivide,
+    ArrayOperationMod,
+    ArrayOperationPower
+};
+
+enum ArrayComparison{
+    ArrayComparisonLessThan,
+    ArrayComparisonGreaterThan,
+    ArrayComparisonLessThanOrEquals,
+    ArrayComparisonGreaterThanOrEquals,
+    ArrayComparisonEquals,
+    ArrayComparisonNotEquals
+};
+
+// element wise loops over numbers, the shorter parameter is repeated: element i of the result pairs
+// left[i % leftSize] with right[i % rightSize], without dividing per element
+// the loops are compiled for AVX-512, AVX2 and the baseline instruction set, the best one is picked when the program loads
+class ArrayKernels{
+public:
+    // the result may be one of the parameters if it has the size of the result,
+    // the divisors of divide and mod must not be 0, which hasZero checks first
+    static void calculate(
+        ArrayOperation operation,
+        const double* left,
+        size_t leftSize,
+        const double* right,
+        size_t rightSize,
+        double* result,
+        size_t size);
+
+    // the result is 1 where the comparison holds and 0 elsewhere
+    static void compare(
+        ArrayComparison comparison,
+        const double* left,
+        size_t leftSize,
+        const double* right,
+        size_t rightSize,
+        unsigned char* result,
+        size_t size);
+
+    // the result is 1.0 where the comparison holds and 0.0 elsewhere, for comparisons that are calculated with further
+    static void compare(
+        ArrayComparison comparison,
+        const double* left,
+        size_t leftSize,
+        const double* right,
+        size_t rightSize,
+        double* result,
+        size_t size);
+
+    // the numbers are added left to right to sum
+    static double sum(const double* numbers, size_t size, double sum = 0.0);
+
+    // the numbers are added in independent lanes, so the loop is vectorized, a lane that overflows
+    // can change the result completely, e.g. inf in one lane and -inf in another give NaN
+    static double sumInLanes(const double* numbers, size_t size);
+
+    // Neumaier's compensated summation left to right, continuing from sum and the rounding errors in compensation,
+    // returns the sum with the rounding errors added back, or the sum alone once it isn't finite
+    static double compensatedSum(const double* numbers, size_t size, double& sum, double& compensation);
+
+    // Neumaier's compensated summation in every lane, the rounding errors are added back at the end
+    static double compensatedSumInLanes(const double* numbers, size_t size);
+
+    // the numbers are multiplied left to right into product, a product split into lanes or blocks
+    // would turn an overflow to inf in one of them and a 0 in another into NaN instead of 0
+    static double product(const double* numbers, size_t size, double product = 1.0);
+
+    // the numbers are multiplied left to right from 1, smallest and largest are the least and greatest magnitude
+    // of the running products, which tell if the numbers multiply to the same result after another product
+    static double product(const double* numbers, size_t size, double& smallest, double& largest);
+
+    // sum of character or boolean bytes, which is exact
+    static long long sumBytes(const unsigned char* bytes, size_t size, bool isCharacter);
+
+    // a divisor of mod is 0 if it truncates to 0
+    static bool hasZero(const double* numbers, size_t size, bool isTruncated);
+
+    static bool hasNaN(const double* numbers, size_t size);
+};
@@ -0,0 +1,127 @@
+#include "ArraySort.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+void ArraySort::sortNumbers(double* numbers, size_t size)
+{
+    const int runs = size < PARALLEL_SORT_SIZE ? 1 : ThreadPool::getInstance().getSize();
+    std::vector<double> buffer(size < RADIX_SORT_SIZE ? 0 : size);
+    if(runs == 1){
+        sortRun(numbers, buffer.data(), size);
+        return;
+    }
+
+    std::vector<size_t> bounds(runs + 1);
+    for(int i=0; i<=runs; i++)
+        bounds[i] = size * i / runs;
+
+    ThreadPool& pool = ThreadPool::getInstance();
+    TaskGroup group;
+    for(int i=0; i<runs; i++){
+        const size_t begin = bounds[i];
+        const size_t runSize = bounds[i + 1] - begin;
+        double* scratch = buffer.data() + begin;
+        pool.submit(group, [numbers, scratch, begin, runSize](){ sortRun(numbers + begin, scratch, runSize); });
+    }
+    pool.wait(group);
+
+    mergeRuns(numbers, buffer.data(), bounds.data(), runs);
+}
+
+void ArraySort::sortBytes(unsigned char* bytes, size_t size, bool isCharacter)
+{
+    size_t counts[RADIX_BUCKETS] = {};
+    for(size_t i=0; i<size; i++)
+        counts[bytes[i]]++;
+
+    // negative chars are the bytes from 128
+    const int first = isCharacter && std::numeric_limits<char>::is_signed ? RADIX_BUCKETS / 2 : 0;
+    size_t position = 0;
+    for(int i=0; i<RADIX_BUCKETS; i++){
+        const int byte = (first + i) % RADIX_BUCKETS;
+        std::memset(bytes + position, byte, counts[byte]);
+        position += counts[byte];
+    }
+}
+
+uint64_t ArraySort::getKey(double number)
+{
+    if(number != number)
+        return std::numeric_limits<uint64_t>::max();
+
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+    const uint64_t sign = 1ULL << 63;
+    return (bits & sign) != 0 ? ~bits : bits | sign;
+}
+
+void ArraySort::sortRun(double* numbers, double* buffer, size_t size)
+{
+    if(size < RADIX_SORT_SIZE){
+        std::sort(numbers, numbers + size, [](double a, double b){ return getKey(a) < getKey(b); });
+        return;
+    }
+
+    radixSort(numbers, buffer, size);
+}
+
+void ArraySort::radixSort(double* numbers, double* buffer, size_t size)
+{
+    // the digits of every pass are counted in one read of the numbers
+    std::vector<size_t> counts(RADIX_PASSES * RADIX_BUCKETS);
+    for(size_t i=0; i<size; i++){
+        const uint64_t key = getKey(numbers[i]);
+        for(int pass=0; pass<RADIX_PASSES; pass++)
+            counts[pass * RADIX_BUCKETS + ((key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1))]++;
+    }
+
+    double* source = numbers;
+    double* destination = buffer;
+    for(int pass=0; pass<RADIX_PASSES; pass++){
+        const int shift = pass * RADIX_BITS;
+        size_t* count = &counts[pass * RADIX_BUCKETS];
+        if(count[(getKey(source[0]) >> shift) & (RADIX_BUCKETS - 1)] == size)
+            continue;
+
+        size_t offsets[RADIX_BUCKETS];
+        size_t offset = 0;
+        for(int i=0; i<RADIX_BUCKETS; i++){
+            offsets[i] = offset;
+            offset += count[i];
+        }
+
+        for(size_t i=0; i<size; i++)
+            destination[offsets[(getKey(source[i]) >> shift) & (RADIX_BUCKETS - 1)]++] = source[i];
+        std::swap(source, destination);
+    }
+
+    if(source != numbers)
+        std::memcpy(numbers, source, size * sizeof(double));
+}
+
+void ArraySort::mergeRuns(double* numbers, double* buffer, const size_t* bounds, int runs)
+{
+    ThreadPool& pool = ThreadPool::getInstance();
+    double* source = numbers;
+    double* destination = buffer;
+    for(int width=1; width<runs; width*=2){
+        TaskGroup group;
+        for(int i=0; i<runs; i+=2*width){
+            const size_t begin = bounds[i];
+            const size_t middle = bounds[std::min(i + width, runs)];
+            const size_t end = bounds[std::min(i + 2 * width, runs)];
+            pool.submit(group, [source, destination, begin, middle, end](){
+                std::merge(source + begin, source + middle, source + middle, source + end, destination + begin,
+                    [](double a, double b){ return getKey(a) < getKey(b); });
+            });
+        }
+        pool.wait(group);
+        std::swap(source, destination);
+    }
+
+    if(source != numbers)
+        std::memcpy(numbers, source, bounds[runs] * sizeof(double));
+}
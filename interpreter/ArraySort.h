@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// sorts arrays in place, large arrays of numbers are radix sorted on the bits of the doubles,
+// very large ones are sorted in runs on the thread pool and merged
+class ArraySort{
+public:
+    // ascending, -0 comes before 0 and NaN comes last
+    static void sortNumbers(double* numbers, size_t size);
+
+    // counting sort, characters are ordered as chars
+    static void sortBytes(unsigned char* bytes, size_t size, bool isCharacter);
+
+private:
+    // arrays smaller than this are sorted by comparison
+    static const size_t RADIX_SORT_SIZE = 4096;
+    // arrays of at least this many numbers are sorted on the thread pool
+    static const size_t PARALLEL_SORT_SIZE = 1 << 20;
+    static const int RADIX_BITS = 8;
+    static const int RADIX_BUCKETS = 1 << RADIX_BITS;
+    static const int RADIX_PASSES = 64 / RADIX_BITS;
+
+    // unsigned integer in the order of the numbers, negative numbers have their bits flipped
+    static uint64_t getKey(double number);
+
+    // sorts a run, buffer is scratch space of the same size
+    static void sortRun(double* numbers, double* buffer, size_t size);
+
+    // least significant digit first, digits that are equal in every key are skipped
+    static void radixSort(double* numbers, double* buffer, size_t size);
+
+    // merges the sorted runs that start at bounds in rounds of pairs, bounds ends with the size
+    static void mergeRuns(double* numbers, double* buffer, const size_t* bounds, int runs);
+};
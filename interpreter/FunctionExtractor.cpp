@@ -1,13 +1,15 @@
 #include "FunctionExtractor.h"
 #include "../util/TokenSubArrayFinder.h"
 
-bool FunctionExtractor::extractFunctions(const std::vector<Token> &tokens, std::vector<const Token*> &dest)
+bool FunctionExtractor::extractFunctions(std::vector<Token> &tokens, std::vector<const Token*> &dest)
 {
     dest.clear();
+    std::vector<int> positions;
     const int size = tokens.size();
     for(int i=0; i<size; i++){
         if(tokens[i].id != TokenIdFunctionDeclaration){
             dest.push_back(&tokens[i]);
+            positions.push_back(i);
         }else{
             while(tokens[i].id != TokenIdOpenCurly && i<size)
                 i++;
@@ -21,5 +23,11 @@ bool FunctionExtractor::extractFunctions(const std::vector<Token> &tokens, std::
         }
     }
 
+    std::vector<int> jumps;
+    TokenSubArrayFinder::computeJumps(dest, jumps);
+    const int destSize = dest.size();
+    for(int i=0; i<destSize; i++)
+        tokens[positions[i]].jump = jumps[i];
+
     return true;
-}
\ No newline at end of file
+}
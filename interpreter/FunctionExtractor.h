@@ -4,5 +4,6 @@
 
 class FunctionExtractor{
 public:
-    static bool extractFunctions(const std::vector<Token> &tokens, std::vector<const Token*> &dest);
+    // also computes the jump offsets of the extracted tokens
+    static bool extractFunctions(std::vector<Token> &tokens, std::vector<const Token*> &dest);
 };
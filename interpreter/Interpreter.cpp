@@ -2,42 +2,75 @@
 #include "../util/TokenSubArrayFinder.h"
 #include "InterpreterCalculator.h"
 #include "../token/OperatorArguments.h"
+#include "../compiler/Compiler.h"
+#include "../compiler/BytecodeCompiler.h"
+#include "../compiler/Optimizer.h"
 #include <cassert>
+#include <tuple>
+#include <utility>
 
-struct Loop{
-    std::vector<const Token*> condition;
-    int loopStart;
-    int loopEnd;
-};
+bool Interpreter::isMemoization = false;
+thread_local bool Interpreter::isReportingErrors = true;
 
-Interpreter::Interpreter(IRuntimeErrorReporter* errorReporter, IInterpreterIO* interpreterIO)
+Interpreter::Interpreter(IRuntimeErrorReporter* errorReporter, IInterpreterIO* interpreterIO, InterpreterEngine engine)
 {
     assert(interpreterIO != nullptr);
     this->errorReporter = errorReporter;
     this->interpreterIO = interpreterIO;
+    this->engine = engine;
+#ifdef INTERPRETER_COUNT_INSTRUCTIONS
+    executedInstructions = 0;
+#endif
 }
 
 bool Interpreter::execute(const std::vector<const Token*> &tokens, const std::unordered_map<std::string, Function>& functions, Value& result)
 {
-    ProgramState programState = {functions,{}, {}};
-    Value empty;
-    bool successfulExecution = execute(tokens, programState,  empty, empty, result);
-    joinThreads(programState);
+    ProgramState programState;
+    programState.functions = functions;
+    return execute(tokens, programState, result);
+}
 
-    return successfulExecution;
+void Interpreter::setMemoization(bool isEnabled)
+{
+    isMemoization = isEnabled;
 }
 
- bool Interpreter::execute(const std::vector<const Token*> &tokens, ProgramState& programState, Value& result)
- {
+bool Interpreter::execute(const std::vector<const Token*> &tokens, ProgramState& programState, Value& result)
+{
+    // compiled code has to outlive the threads
+    SyntaxBlock program;
+    BytecodeBlock bytecode;
     Value empty;
-    bool successfulExecution = execute(tokens, programState,  empty, empty, result);
+    bool successfulExecution;
+    allocateVariables(tokens, programState);
+    createMemoCaches(programState);
+    if(engine == InterpreterEngineTokens){
+        successfulExecution = execute(tokens, programState, empty, empty, result);
+    }else{
+        // functions are compiled on every call since they can be redefined between calls
+        Compiler::compileFunctions(programState.functions, programState.compiledFunctions);
+        Compiler::compile(tokens, programState.functions, programState.compiledFunctions, program);
+        Optimizer::optimizeFunctions(programState.compiledFunctions);
+        Optimizer::optimize(program);
+        if(engine == InterpreterEngineBytecode){
+            BytecodeCompiler::compileFunctions(programState.compiledFunctions, programState.bytecodeFunctions);
+            BytecodeCompiler::compile(program, programState.compiledFunctions, programState.bytecodeFunctions, bytecode);
+        }
+        setMemoCaches(programState);
+
+        if(engine == InterpreterEngineSyntaxTree)
+            successfulExecution = evaluate(program, programState, empty, empty, result);
+        else
+            successfulExecution = run(bytecode, programState, empty, empty, result);
+    }
     joinThreads(programState);
+    collectMemoStatistics(programState);
 
     return successfulExecution;
 }
 
 void Interpreter::executeOnThread(
-    std::vector<const Token*> tokens,
+    TokenRange tokens,
     ProgramState& programState,
     Value argumentA,
     Value argumentB)
@@ -48,22 +81,839 @@ void Interpreter::executeOnThread(
     }
 }
 
+void Interpreter::evaluateOnThread(
+    const SyntaxBlock* block,
+    ProgramState& programState,
+    Value argumentA,
+    Value argumentB)
+{
+    Value ignore;
+    if(!evaluate(*block, programState, argumentA, argumentB, ignore)){
+        report(RuntimeErrorTypeThreadHadError);
+    }
+}
+
+bool Interpreter::evaluate(
+    const SyntaxBlock& block,
+    ProgramState& programState,
+    const Value& argumentA,
+    const Value& argumentB,
+    Value& result)
+{
+    if(!block.isCompiled)
+        return execute(block.tokens, programState, argumentA, argumentB, result);
+
+    BlockEvaluation evaluation = {block, programState, argumentA, argumentB, std::make_unique<Value>(), {}, false, false};
+    if(!evaluateStatements(block.statements, evaluation) && !(evaluation.isHandedOver && evaluation.handOverSucceeded))
+        return false;
+
+    result = std::move(*evaluation.lastResult);
+    return true;
+}
+
+bool Interpreter::evaluateStatements(const std::vector<SyntaxNode>& statements, BlockEvaluation& evaluation)
+{
+    for(const auto& statement: statements){
+        if(!evaluateStatement(statement, evaluation))
+            return false;
+    }
+    return true;
+}
+
+bool Interpreter::evaluateStatement(const SyntaxNode& statement, BlockEvaluation& evaluation)
+{
+    ProgramState& programState = evaluation.programState;
+    switch(statement.type){
+        case SyntaxNodeAssign:
+        case SyntaxNodeWrite:
+        case SyntaxNodeWriteText:
+        {
+            auto value = std::make_unique<Value>();
+            if(!evaluate(*statement.block, programState, evaluation.argumentA, evaluation.argumentB, *value))
+                return false;
+
+            if(value->size() == 0){
+                report(evaluation.block.tokens, statement.position, RuntimeErrorTypeEmptyData);
+                return false;
+            }
+
+            if(statement.type == SyntaxNodeWrite)
+                writeNumbers(programState, *value);
+            else if(statement.type == SyntaxNodeWriteText)
+                writeText(programState, *value);
+            else
+                setVariable(*value, *statement.token, programState);
+            evaluation.lastResult = std::move(value);
+            return true;
+        }
+        case SyntaxNodeIf:
+        {
+            Value conditionResult;
+            if(!evaluate(*statement.block, programState, evaluation.argumentA, evaluation.argumentB, conditionResult))
+                return false;
+
+            if(conditionResult[0] != 0.0)
+                return evaluateStatements(statement.children, evaluation);
+            return true;
+        }
+        case SyntaxNodeLoop:
+        {
+            Value conditionResult;
+            if(!evaluate(*statement.block, programState, evaluation.argumentA, evaluation.argumentB, conditionResult))
+                return false;
+
+            evaluation.loops.push_back(&statement);
+            while(conditionResult[0] != 0){
+                if(!evaluateStatements(statement.children, evaluation))
+                    return false;
+                if(!evaluate(*statement.block, programState, evaluation.argumentA, evaluation.argumentB, conditionResult))
+                    return false;
+            }
+            evaluation.loops.pop_back();
+            return true;
+        }
+        case SyntaxNodeAsync:
+        {
+            programState.isConcurrent = true;
+            ThreadPool::getInstance().submit(programState.tasks, std::bind(&Interpreter::evaluateOnThread, this, statement.block.get(), std::ref(programState), evaluation.argumentA, evaluation.argumentB));
+            return true;
+        }
+        case SyntaxNodeJoin:
+        {
+            joinThreads(programState);
+            return true;
+        }
+        default:
+        {
+            std::unique_ptr<Value> value;
+            if(!evaluateExpression(statement, evaluation, value))
+                return false;
+
+            evaluation.lastResult = std::move(value);
+            return true;
+        }
+    }
+}
+
+bool Interpreter::evaluateExpression(const SyntaxNode& expression, BlockEvaluation& evaluation, std::unique_ptr<Value>& result)
+{
+    if(!evaluateNode(expression, evaluation, result))
+        return false;
+
+    if(result->size() == 0){
+        handOver(evaluation, expression.position, std::move(result), std::make_unique<Value>(), nullptr);
+        return false;
+    }
+    return true;
+}
+
+bool Interpreter::evaluateNode(const SyntaxNode& node, BlockEvaluation& evaluation, std::unique_ptr<Value>& result)
+{
+    ProgramState& programState = evaluation.programState;
+    const Value& argumentA = evaluation.argumentA;
+    const Value& argumentB = evaluation.argumentB;
+
+    switch(node.type)
+    {
+    case SyntaxNodeLiteral:
+        result = std::make_unique<Value>(node.token->val);
+        return true;
+    case SyntaxNodeVariable:
+        result = std::make_unique<Value>();
+        getVariable(*result, *node.token, programState);
+        return true;
+    case SyntaxNodeLeftParam:
+        result = std::make_unique<Value>(argumentA);
+        if(argumentA.size() == 0)
+            result->push_back(0.0);
+        return true;
+    case SyntaxNodeRightParam:
+        result = std::make_unique<Value>(argumentB);
+        if(argumentB.size() == 0)
+            result->push_back(0.0);
+        return true;
+    case SyntaxNodeRead:
+        result = readNumbers(programState);
+        return true;
+    case SyntaxNodeReadText:
+        result = readText(programState);
+        return true;
+    case SyntaxNodeGroup:
+        result = std::make_unique<Value>();
+        return evaluate(*node.block, programState, argumentA, argumentB, *result);
+    case SyntaxNodeCall:
+        result = std::make_unique<Value>();
+        return callCompiled(*node.function, programState, argumentA, argumentB, *result);
+    case SyntaxNodeOperation:
+    {
+        std::unique_ptr<Value> left;
+        if(node.children[0].type == SyntaxNodeEmpty)
+            left = std::make_unique<Value>();
+        else if(!evaluateExpression(node.children[0], evaluation, left))
+            return false;
+
+        std::unique_ptr<Value> right;
+        if(node.children.size() > 1){
+            if(!evaluateNode(node.children[1], evaluation, right))
+                return false;
+
+            if(right->size() == 0){
+                handOver(evaluation, node.children[1].position, std::move(left), std::move(right), node.token);
+                return false;
+            }
+        }else{
+            right = std::make_unique<Value>();
+        }
+
+        bool hadError = false;
+        if(node.function != nullptr){
+            result = std::make_unique<Value>();
+            hadError = !callCompiled(*node.function, programState, *left, *right, *result);
+        }else{
+            result = std::move(left);
+            executeOperationOrFunction(*result, *right, *node.token, argumentA, argumentB, programState, *result, hadError);
+        }
+
+        if(hadError){
+            report(evaluation.block.tokens, node.position, RuntimeErrorTypeOperatorError);
+            return false;
+        }
+        return true;
+    }
+    case SyntaxNodeApplyToEach:
+    {
+        std::unique_ptr<Value> left;
+        if(!evaluateExpression(node.children[0], evaluation, left))
+            return false;
+
+        // errors are reported and the partial result is kept like in the token interpreter
+        bool hadError = false;
+        result = executeModifier(*left, evaluation.block.tokens, programState, argumentA, argumentB, node.position-1, hadError);
+        return true;
+    }
+    default:
+        result = std::make_unique<Value>();
+        return true;
+    }
+}
+
+void Interpreter::handOver(
+    BlockEvaluation& evaluation,
+    int position,
+    std::unique_ptr<Value> leftParameter,
+    std::unique_ptr<Value> rightParameter,
+    const Token* operation)
+{
+    ExecutionState state;
+    state.leftParameter = std::move(leftParameter);
+    state.rightParameter = std::move(rightParameter);
+    state.lastResult = std::move(evaluation.lastResult);
+    state.operation = operation;
+    for(const auto loop: evaluation.loops)
+        state.loopStack.push({loop->block->tokens, loop->position, loop->endPosition});
+
+    evaluation.lastResult = std::make_unique<Value>();
+    evaluation.isHandedOver = true;
+    evaluation.handOverSucceeded = execute(
+        evaluation.block.tokens,
+        position+1,
+        evaluation.programState,
+        evaluation.argumentA,
+        evaluation.argumentB,
+        state,
+        *evaluation.lastResult);
+}
+
+bool Interpreter::callFunction(
+    const Token& function,
+    ProgramState& programState,
+    const Value& argumentA,
+    const Value& argumentB,
+    Value& result)
+{
+    if(engine == InterpreterEngineBytecode){
+        const auto bytecode = programState.bytecodeFunctions.find(function.str);
+        if(bytecode != programState.bytecodeFunctions.end())
+            return callCompiled(bytecode->second, programState, argumentA, argumentB, result);
+    }else if(engine == InterpreterEngineSyntaxTree){
+        const auto compiled = programState.compiledFunctions.find(function.str);
+        if(compiled != programState.compiledFunctions.end())
+            return callCompiled(compiled->second, programState, argumentA, argumentB, result);
+    }
+
+    const auto found = programState.memoCaches.find(function.str);
+    if(found == programState.memoCaches.end())
+        return execute(getFunction(function, programState).body, programState, argumentA, argumentB, result);
+
+    return found->second.call(argumentA, argumentB, result, [&](){
+        return execute(getFunction(function, programState).body, programState, argumentA, argumentB, result);
+    });
+}
+
+bool Interpreter::callCompiled(
+    const BytecodeBlock& function,
+    ProgramState& programState,
+    const Value& argumentA,
+    const Value& argumentB,
+    Value& result)
+{
+    if(function.memoCache == nullptr)
+        return run(function, programState, argumentA, argumentB, result);
+
+    return function.memoCache->call(argumentA, argumentB, result, [&](){
+        return run(function, programState, argumentA, argumentB, result);
+    });
+}
+
+bool Interpreter::callCompiled(
+    const SyntaxBlock& function,
+    ProgramState& programState,
+    const Value& argumentA,
+    const Value& argumentB,
+    Value& result)
+{
+    if(function.memoCache == nullptr)
+        return evaluate(function, programState, argumentA, argumentB, result);
+
+    return function.memoCache->call(argumentA, argumentB, result, [&](){
+        return evaluate(function, programState, argumentA, argumentB, result);
+    });
+}
+
+void Interpreter::runOnThread(
+    const BytecodeBlock* block,
+    ProgramState& programState,
+    Value argumentA,
+    Value argumentB)
+{
+    Value ignore;
+    if(!run(*block, programState, argumentA, argumentB, ignore)){
+        report(RuntimeErrorTypeThreadHadError);
+    }
+}
+
+// operators replace their parameters on the stack with the result, the left parameter holds the result
+#define VM_DYADIC_OPERATOR(opcode, calculation)                                                                 \
+    VM_OPCODE(opcode):                                                                                          \
+    {                                                                                                           \
+        Value& left = stack[stack.size()-2];                                                                    \
+        InterpreterCalculator::calculation(left, stack.back(), left, hadError, getReporter());                  \
+        stack.pop_back();                                                                                       \
+        if(hadError){                                                                                           \
+            report(instruction->source->tokens, instruction->argument, RuntimeErrorTypeOperatorError);          \
+            goto finish;                                                                                        \
+        }                                                                                                       \
+        instruction++;                                                                                          \
+        VM_DISPATCH();                                                                                          \
+    }
+
+#define VM_MONADIC_OPERATOR(opcode, calculation)                                                                \
+    VM_OPCODE(opcode):                                                                                          \
+    {                                                                                                           \
+        InterpreterCalculator::calculation(stack.back(), stack.back(), hadError, getReporter());                \
+        if(hadError){                                                                                           \
+            report(instruction->source->tokens, instruction->argument, RuntimeErrorTypeOperatorError);          \
+            goto finish;                                                                                        \
+        }                                                                                                       \
+        instruction++;                                                                                          \
+        VM_DISPATCH();                                                                                          \
+    }
+
+// threaded dispatch with computed goto where the compiler supports it,
+// a computed goto doesn't destroy locals so handlers keep them in an inner scope
+#if defined(__GNUC__)
+    #define VM_OPCODE(opcode) label##opcode
+    #define VM_DISPATCH_INSTRUCTION() goto *dispatchTable[instruction->opcode]
+#else
+    #define VM_OPCODE(opcode) case opcode
+    #define VM_DISPATCH_INSTRUCTION() goto dispatch
+#endif
+
+#ifdef INTERPRETER_COUNT_INSTRUCTIONS
+    #define VM_DISPATCH() executed++; VM_DISPATCH_INSTRUCTION()
+#else
+    #define VM_DISPATCH() VM_DISPATCH_INSTRUCTION()
+#endif
+
+bool Interpreter::run(
+    const BytecodeBlock& block,
+    ProgramState& programState,
+    const Value& argumentA,
+    const Value& argumentB,
+    Value& result)
+{
+    if(!block.source->isCompiled)
+        return execute(block.source->tokens, programState, argumentA, argumentB, result);
+
+#if defined(__GNUC__)
+    // same order as Opcode
+    static const void* dispatchTable[] = {
+        &&labelOpcodeLiteral,
+        &&labelOpcodeVariable,
+        &&labelOpcodeLeftParam,
+        &&labelOpcodeRightParam,
+        &&labelOpcodeRead,
+        &&labelOpcodeReadText,
+        &&labelOpcodeEmpty,
+        &&labelOpcodeEvaluate,
+        &&labelOpcodeCall,
+        &&labelOpcodeCallWithParameters,
+        &&labelOpcodeApplyToEach,
+        &&labelOpcodeHandOverIfEmpty,
+        &&labelOpcodeFused,
+        &&labelOpcodeClearCommon,
+        &&labelOpcodeLoadCommon,
+        &&labelOpcodeLoadInvariant,
+        &&labelOpcodeStoreCommon,
+        &&labelOpcodeCountedCondition,
+        &&labelOpcodeCountedStep,
+        &&labelOpcodeAdd,
+        &&labelOpcodeSubtract,
+        &&labelOpcodeMultiply,
+        &&labelOpcodeDivide,
+        &&labelOpcodeMod,
+        &&labelOpcodePower,
+        &&labelOpcodeLessThan,
+        &&labelOpcodeGreaterThan,
+        &&labelOpcodeLessThanOrEquals,
+        &&labelOpcodeGreaterThanOrEquals,
+        &&labelOpcodeIsEquals,
+        &&labelOpcodeNotEquals,
+        &&labelOpcodeUnion,
+        &&labelOpcodeSelect,
+        &&labelOpcodeLeftRotate,
+        &&labelOpcodeRightRotate,
+        &&labelOpcodeRemove,
+        &&labelOpcodeRemain,
+        &&labelOpcodeCountEach,
+        &&labelOpcodeIterate,
+        &&labelOpcodeLogicalNot,
+        &&labelOpcodeCount,
+        &&labelOpcodeSumAll,
+        &&labelOpcodeMultiplyAll,
+        &&labelOpcodeRandom,
+        &&labelOpcodeSine,
+        &&labelOpcodeConvert,
+        &&labelOpcodeMakeSet,
+        &&labelOpcodeCeil,
+        &&labelOpcodeFloor,
+        &&labelOpcodeRound,
+        &&labelOpcodeSort,
+        &&labelOpcodeReverse,
+        &&labelOpcodeSetLastResult,
+        &&labelOpcodeAssign,
+        &&labelOpcodeWrite,
+        &&labelOpcodeWriteText,
+        &&labelOpcodeJump,
+        &&labelOpcodeJumpIfFalse,
+        &&labelOpcodeAsync,
+        &&labelOpcodeJoin,
+        &&labelOpcodeReturn
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == OpcodeNumberOfOpcodes, "dispatch table doesn't match the opcodes");
+#endif
+
+    // values are kept in the stack, small ones don't allocate
+    std::vector<Value> stack;
+    stack.reserve(INITIAL_STACK_CAPACITY);
+    Value lastResult;
+    // values of the common parenthesis of the current statement and of the invariant parenthesis of the loops
+    std::vector<Value> commonValues(block.commonValues);
+    const Instruction* const code = block.code.data();
+    const Instruction* instruction = code;
+    bool hadError = false;
+    bool succeeded = false;
+#ifdef INTERPRETER_COUNT_INSTRUCTIONS
+    unsigned long long executed = 0;
+#endif
+
+    VM_DISPATCH();
+#if !defined(__GNUC__)
+dispatch:
+    switch(instruction->opcode){
+#endif
+    VM_OPCODE(OpcodeLiteral):
+    {
+        stack.push_back(instruction->token->val);
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeVariable):
+    {
+        stack.emplace_back();
+        getVariable(stack.back(), *instruction->token, programState);
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeLeftParam):
+    {
+        stack.push_back(argumentA);
+        if(argumentA.size() == 0)
+            stack.back().push_back(0.0);
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeRightParam):
+    {
+        stack.push_back(argumentB);
+        if(argumentB.size() == 0)
+            stack.back().push_back(0.0);
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeRead):
+    {
+        stack.push_back(std::move(*readNumbers(programState)));
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeReadText):
+    {
+        stack.push_back(std::move(*readText(programState)));
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeEmpty):
+    {
+        stack.emplace_back();
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeEvaluate):
+    VM_OPCODE(OpcodeCall):
+    {
+        stack.emplace_back();
+        if(!callCompiled(*instruction->block, programState, argumentA, argumentB, stack.back()))
+            goto finish;
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeCallWithParameters):
+    {
+        bool succeededCall;
+        {
+            Value right = std::move(stack.back());
+            stack.pop_back();
+            Value left = std::move(stack.back());
+            succeededCall = callCompiled(*instruction->block, programState, left, right, stack.back());
+        }
+        if(!succeededCall){
+            report(instruction->source->tokens, instruction->argument, RuntimeErrorTypeOperatorError);
+            goto finish;
+        }
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeApplyToEach):
+    {
+        // errors are reported and the partial result is kept like in the token interpreter
+        stack.back() = std::move(*executeModifier(stack.back(), instruction->source->tokens, programState, argumentA, argumentB, instruction->argument, hadError));
+        hadError = false;
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeHandOverIfEmpty):
+    {
+        if(stack.back().size() != 0){
+            instruction++;
+            VM_DISPATCH();
+        }
+
+        const BytecodeHandOver& handOver = *instruction->handOver;
+        bool succeededHandOver;
+        {
+            ExecutionState state;
+            if(handOver.operation != nullptr){
+                state.rightParameter = std::make_unique<Value>(std::move(stack.back()));
+                stack.pop_back();
+                state.operation = handOver.operation;
+            }
+            state.leftParameter = std::make_unique<Value>(std::move(stack.back()));
+            stack.pop_back();
+            for(const auto loop: handOver.loops)
+                state.loopStack.push({loop->block->tokens, loop->position, loop->endPosition});
+
+            if(handOver.exit == BytecodeHandOver::EXIT_RETURN){
+                state.lastResult = std::make_unique<Value>(std::move(lastResult));
+                succeeded = execute(handOver.source->tokens, handOver.position+1, programState, argumentA, argumentB, state, result);
+                goto finish;
+            }
+
+            stack.emplace_back();
+            succeededHandOver = execute(handOver.source->tokens, handOver.position+1, programState, argumentA, argumentB, state, stack.back());
+        }
+        if(!succeededHandOver)
+            goto finish;
+        instruction = code + handOver.exit;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeFused):
+    {
+        // small arrays and everything the fused expression can't calculate exactly run the operators
+        if(stack.back().size() >= InterpreterCalculator::FUSED_SIZE && evaluateFused(*instruction->fused, argumentA, argumentB, programState, stack.back()))
+            instruction = code + instruction->argument;
+        else
+            instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeClearCommon):
+    {
+        for(int i=0; i<instruction->argument; i++)
+            commonValues[instruction->common + i].clear();
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeLoadCommon):
+    {
+        // an empty value is calculated again, it hands over like the first time
+        const Value& common = commonValues[instruction->common];
+        if(common.size() != 0){
+            stack.push_back(common);
+            instruction = code + instruction->argument;
+        }else{
+            instruction++;
+        }
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeLoadInvariant):
+    {
+        // variables read by the parenthesis may be assigned by async blocks between iterations
+        const Value& invariant = commonValues[instruction->common];
+        if(invariant.size() != 0 && !programState.isConcurrent.load(std::memory_order_relaxed)){
+            stack.push_back(invariant);
+            instruction = code + instruction->argument;
+        }else{
+            instruction++;
+        }
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeStoreCommon):
+    {
+        commonValues[instruction->common] = stack.back();
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeCountedCondition):
+    {
+        // the values of the condition are single numbers, it's compared like the operator compares them
+        const CountedLoop& counted = *instruction->counted;
+        double variable, limit;
+        if(!getCountedNumber(*counted.variable, programState, variable) || !getCountedNumber(*counted.limit, programState, limit)){
+            instruction++;
+            VM_DISPATCH();
+        }
+
+        bool condition;
+        switch(counted.comparison){
+            case OpcodeLessThan: condition = variable < limit; break;
+            case OpcodeGreaterThan: condition = variable > limit; break;
+            case OpcodeLessThanOrEquals: condition = variable <= limit; break;
+            default: condition = variable >= limit; break;
+        }
+        const Instruction* jump = code + instruction->argument;
+        instruction = condition ? jump + 1 : code + jump->argument;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeCountedStep):
+    {
+        // a variable that holds one number is updated in its slot, others are assigned by the instructions
+        Variable& stored = programState.variables[instruction->counted->variable->slot];
+        if(programState.isConcurrent.load(std::memory_order_relaxed) || !stored.isDefined || stored.value.size() != 1 ||
+            stored.value.isRange() || stored.value.type() != ValueTypeNumber){
+            instruction++;
+            VM_DISPATCH();
+        }
+
+        stored.value.mutableData()[0] += instruction->counted->step;
+        lastResult = stored.value;
+        instruction = code + instruction->argument;
+        VM_DISPATCH();
+    }
+    VM_DYADIC_OPERATOR(OpcodeAdd, add)
+    VM_DYADIC_OPERATOR(OpcodeSubtract, subtract)
+    VM_DYADIC_OPERATOR(OpcodeMultiply, multiply)
+    VM_DYADIC_OPERATOR(OpcodeDivide, divide)
+    VM_DYADIC_OPERATOR(OpcodeMod, mod)
+    VM_DYADIC_OPERATOR(OpcodePower, power)
+    VM_DYADIC_OPERATOR(OpcodeLessThan, lessThan)
+    VM_DYADIC_OPERATOR(OpcodeGreaterThan, greaterThan)
+    VM_DYADIC_OPERATOR(OpcodeLessThanOrEquals, lessThanOrEquals)
+    VM_DYADIC_OPERATOR(OpcodeGreaterThanOrEquals, greaterThanOrEquals)
+    VM_DYADIC_OPERATOR(OpcodeIsEquals, equals)
+    VM_DYADIC_OPERATOR(OpcodeNotEquals, notEquals)
+    VM_DYADIC_OPERATOR(OpcodeUnion, findUnion)
+    VM_DYADIC_OPERATOR(OpcodeSelect, select)
+    VM_DYADIC_OPERATOR(OpcodeLeftRotate, leftRotate)
+    VM_DYADIC_OPERATOR(OpcodeRightRotate, rightRotate)
+    VM_DYADIC_OPERATOR(OpcodeRemove, remove)
+    VM_DYADIC_OPERATOR(OpcodeRemain, remain)
+    VM_DYADIC_OPERATOR(OpcodeCountEach, countEach)
+    VM_MONADIC_OPERATOR(OpcodeIterate, iterate)
+    VM_MONADIC_OPERATOR(OpcodeLogicalNot, logicalNot)
+    VM_MONADIC_OPERATOR(OpcodeCount, count)
+    VM_MONADIC_OPERATOR(OpcodeSumAll, sumAll)
+    VM_MONADIC_OPERATOR(OpcodeMultiplyAll, multiplyAll)
+    VM_MONADIC_OPERATOR(OpcodeRandom, randomize)
+    VM_MONADIC_OPERATOR(OpcodeSine, sine)
+    VM_MONADIC_OPERATOR(OpcodeConvert, convert)
+    VM_MONADIC_OPERATOR(OpcodeMakeSet, makeSet)
+    VM_MONADIC_OPERATOR(OpcodeCeil, findCeil)
+    VM_MONADIC_OPERATOR(OpcodeFloor, findFloor)
+    VM_MONADIC_OPERATOR(OpcodeRound, findRound)
+    VM_MONADIC_OPERATOR(OpcodeSort, sortArray)
+    VM_MONADIC_OPERATOR(OpcodeReverse, reverseArray)
+    VM_OPCODE(OpcodeSetLastResult):
+    {
+        lastResult = std::move(stack.back());
+        stack.pop_back();
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeAssign):
+    VM_OPCODE(OpcodeWrite):
+    VM_OPCODE(OpcodeWriteText):
+    {
+        lastResult = std::move(stack.back());
+        stack.pop_back();
+        if(lastResult.size() == 0){
+            report(instruction->source->tokens, instruction->argument, RuntimeErrorTypeEmptyData);
+            goto finish;
+        }
+
+        if(instruction->opcode == OpcodeWrite)
+            writeNumbers(programState, lastResult);
+        else if(instruction->opcode == OpcodeWriteText)
+            writeText(programState, lastResult);
+        else
+            setVariable(lastResult, *instruction->token, programState);
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeJump):
+    {
+        instruction = code + instruction->argument;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeJumpIfFalse):
+    {
+        const bool condition = stack.back()[0] != 0.0;
+        stack.pop_back();
+        instruction = condition ? instruction + 1 : code + instruction->argument;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeAsync):
+    {
+        programState.isConcurrent = true;
+        ThreadPool::getInstance().submit(programState.tasks, std::bind(&Interpreter::runOnThread, this, instruction->block, std::ref(programState), argumentA, argumentB));
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeJoin):
+    {
+        joinThreads(programState);
+        instruction++;
+        VM_DISPATCH();
+    }
+    VM_OPCODE(OpcodeReturn):
+    {
+        result = std::move(lastResult);
+        succeeded = true;
+        goto finish;
+    }
+#if !defined(__GNUC__)
+    default:
+        goto finish;
+    }
+#endif
+
+finish:
+#ifdef INTERPRETER_COUNT_INSTRUCTIONS
+    executedInstructions += executed;
+#endif
+    return succeeded;
+}
+
+#undef VM_DYADIC_OPERATOR
+#undef VM_MONADIC_OPERATOR
+#undef VM_OPCODE
+#undef VM_DISPATCH_INSTRUCTION
+#undef VM_DISPATCH
+
+
+bool Interpreter::evaluateFused(
+    const FusedExpression& fused,
+    const Value& argumentA,
+    const Value& argumentB,
+    ProgramState& programState,
+    Value& value)
+{
+    std::vector<Value> variables;
+    variables.reserve(fused.tokens.size());
+    std::vector<const Value*> operands;
+    operands.reserve(fused.steps.size());
+    int token = 0;
+    for(const auto step: fused.steps){
+        switch(step)
+        {
+        case OpcodeEmpty:
+            operands.push_back(&value);
+            break;
+        case OpcodeLiteral:
+            operands.push_back(&fused.tokens[token++]->val);
+            break;
+        case OpcodeVariable:
+            variables.emplace_back();
+            getVariable(variables.back(), *fused.tokens[token++], programState);
+            operands.push_back(&variables.back());
+            break;
+        case OpcodeLeftParam:
+            operands.push_back(&argumentA);
+            break;
+        case OpcodeRightParam:
+            operands.push_back(&argumentB);
+            break;
+        default:
+            break;
+        }
+    }
+
+    Value result;
+    if(!InterpreterCalculator::calculateFused(fused, operands, result))
+        return false;
+
+    value = std::move(result);
+    return true;
+}
+
+bool Interpreter::execute(
+    const TokenRange& tokens,
+    ProgramState& programState,
+    const Value& argumentA,
+    const Value& argumentB,
+    Value& result)
+{
+    ExecutionState state;
+    return execute(tokens, 0, programState, argumentA, argumentB, state, result);
+}
+
 bool Interpreter::execute(
-    const std::vector<const Token*> &tokens,
+    const TokenRange& tokens,
+    int start,
     ProgramState& programState,
     const Value& argumentA,
     const Value& argumentB,
+    ExecutionState& state,
     Value& result)
 {
     const int size = tokens.size();
     bool hadError = false;
-    std::unique_ptr<Value> leftParameter = std::make_unique<Value>();
-    std::unique_ptr<Value> rightParameter = std::make_unique<Value>();
-    std::unique_ptr<Value> lastResult = std::make_unique<Value>();
-    const Token* operation = nullptr;
-    std::stack<Loop> loopStack;
+    std::unique_ptr<Value>& leftParameter = state.leftParameter;
+    std::unique_ptr<Value>& rightParameter = state.rightParameter;
+    std::unique_ptr<Value>& lastResult = state.lastResult;
+    const Token*& operation = state.operation;
+    std::stack<Loop>& loopStack = state.loopStack;
 
-    for(int i=0; i<size; i++){
+    for(int i=start; i<size; i++){
         if(loopStack.size() != 0 && i == loopStack.top().loopEnd){
             Value conditionResult;
             if(!execute(loopStack.top().condition, programState, argumentA, argumentB, conditionResult))
@@ -100,21 +950,19 @@ bool Interpreter::execute(
             }
             case TokenIdIf:
             {
-                std::vector<const Token*> condition;
                 Value conditionResult;
-                int endCondition = TokenSubArrayFinder::findFirstTokenIdInLine(tokens, i, TokenIdOpenCurly);
+                int endCondition = TokenSubArrayFinder::findJumpTarget(tokens, i);
                 if(endCondition == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND){
                     report(tokens, i, RuntimeErrorTypeMissingIfCondition);
                     return false;
                 }
-                TokenSubArrayFinder::findSubArray(tokens, condition, i+1, endCondition-1);
-                if(!execute(condition, programState, argumentA, argumentB, conditionResult))
+                if(!execute(tokens.subRange(i+1, endCondition-1), programState, argumentA, argumentB, conditionResult))
                     return false;
             
                 if(conditionResult[0] != 0.0){
                     i = endCondition;
                 }else{
-                    int afterIfBody = TokenSubArrayFinder::findClosingCurly(tokens, endCondition);
+                    int afterIfBody = TokenSubArrayFinder::findJumpTarget(tokens, endCondition);
                     if(afterIfBody == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND){
                         report(tokens, i, RuntimeErrorTypeInvalidIfSyntax);
                         return false;
@@ -127,13 +975,13 @@ bool Interpreter::execute(
             {
                 Loop loopData;
                 Value conditionResult;
-                loopData.loopStart = TokenSubArrayFinder::findFirstTokenIdInLine(tokens, i, TokenIdOpenCurly);
+                loopData.loopStart = TokenSubArrayFinder::findJumpTarget(tokens, i);
                 if(loopData.loopStart == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND){
                     report(tokens, i, RuntimeErrorTypeMissingLoopCondition);
                     return false;
                 }
-                TokenSubArrayFinder::findSubArray(tokens, loopData.condition, i+1, loopData.loopStart-1);
-                loopData.loopEnd = TokenSubArrayFinder::findClosingCurly(tokens, loopData.loopStart);
+                loopData.condition = tokens.subRange(i+1, loopData.loopStart-1);
+                loopData.loopEnd = TokenSubArrayFinder::findJumpTarget(tokens, loopData.loopStart);
                 if(!execute(loopData.condition, programState, argumentA, argumentB, conditionResult))
                     return false;
 
@@ -170,7 +1018,7 @@ bool Interpreter::execute(
 
                 lastResult = std::move(leftParameter);
                 leftParameter = std::make_unique<Value>();
-                setVariable(*lastResult, tokens[i - 1]->str, programState);
+                setVariable(*lastResult, *tokens[i - 1], programState);
                 i = statementEnd;
                 continue;
             }else{
@@ -199,7 +1047,7 @@ bool Interpreter::execute(
 }
 
 int Interpreter::executeStatement(
-    const std::vector<const Token*> &tokens,
+    const TokenRange& tokens,
     int position,
     ProgramState& programState,
     const Value& argumentA,
@@ -207,12 +1055,9 @@ int Interpreter::executeStatement(
     Value& result,
     bool& hadError)
 {
-    const int statementEnd = TokenSubArrayFinder::findStatementEnd(tokens, position);
-    std::vector<const Token*> statement;
-    TokenSubArrayFinder::findSubArray(tokens, statement, position+1, statementEnd);
-
+    const int statementEnd = TokenSubArrayFinder::findJumpTarget(tokens, position);
     if(!execute(
-        statement,
+        tokens.subRange(position+1, statementEnd),
         programState,
         argumentA,
         argumentB,
@@ -230,7 +1075,7 @@ int Interpreter::executeStatement(
 }
 
 bool Interpreter::checkForCalculation(
-    const std::vector<const Token*> &tokens,
+    const TokenRange& tokens,
     int& position,
     ProgramState& programState,
     const Value& argumentA,
@@ -250,19 +1095,19 @@ bool Interpreter::checkForCalculation(
         return false;
     }
     if(hasRight && rightParameter->size() > 0){
-        leftParameter = executeOperationOrFunction(*leftParameter, *rightParameter, *operation, argumentA, argumentB, programState, hadError);
+        executeOperationOrFunction(*leftParameter, *rightParameter, *operation, argumentA, argumentB, programState, *leftParameter, hadError);
         if(hadError){
             report(tokens, position, RuntimeErrorTypeOperatorError);
 
             return false;
         }
-        rightParameter = std::make_unique<Value>();
+        rightParameter->clear();
                 
     }else if(operation->id == TokenIdApplyToEach){
         leftParameter = executeModifier(*leftParameter, tokens, programState, argumentA, argumentB, position, hadError);
         position++;
     }else if(hasLeft && leftParameter->size() > 0 && (!hasRight)){
-        leftParameter = executeOperationOrFunction(*leftParameter, *rightParameter, *operation, argumentA, argumentB, programState, hadError);
+        executeOperationOrFunction(*leftParameter, *rightParameter, *operation, argumentA, argumentB, programState, *leftParameter, hadError);
         if(hadError){
             report(tokens, position, RuntimeErrorTypeOperatorError);
 
@@ -278,7 +1123,7 @@ bool Interpreter::checkForCalculation(
 
 inline bool Interpreter::getArgumentsAndOperation(
     int& position,
-    const std::vector<const Token*> &tokens,
+    const TokenRange& tokens,
     ProgramState& programState,
     std::unique_ptr<Value>& leftParameter,
     std::unique_ptr<Value>& rightParameter,
@@ -302,7 +1147,7 @@ inline bool Interpreter::getArgumentsAndOperation(
     
 std::unique_ptr<Value> Interpreter::getNextArgument(
     int& position,
-    const std::vector<const Token*> &tokens,
+    const TokenRange& tokens,
     ProgramState& programState,
     const Value& argumentA,
     const Value& argumentB,
@@ -314,7 +1159,7 @@ std::unique_ptr<Value> Interpreter::getNextArgument(
     {
     case TokenIdVariable:
         result = std::make_unique<Value>();
-        getVariable(*result, tokens[position]->str, programState);
+        getVariable(*result, *tokens[position], programState);
         return std::move(result);
     break;
     case TokenIdLiteral:
@@ -341,7 +1186,7 @@ std::unique_ptr<Value> Interpreter::getNextArgument(
         getOperatorOrFunctionParamerters(*(tokens[position]), hasLeft, hasRight, programState);
         if((!hasLeft) && (!hasRight)){
             result = std::make_unique<Value>();
-            hadError = !execute(programState.functions[tokens[position]->str].body, programState, argumentA, argumentB, *result);
+            hadError = !callFunction(*tokens[position], programState, argumentA, argumentB, *result);
             return std::move(result);
         }else{
             hadError = true;
@@ -352,16 +1197,14 @@ std::unique_ptr<Value> Interpreter::getNextArgument(
     break;
     case TokenIdOpenParenthesis:
     {
-        int endPos = TokenSubArrayFinder::findClosingParenthesis(tokens, position);
+        int endPos = TokenSubArrayFinder::findJumpTarget(tokens, position);
         if(endPos == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND){
             hadError = true;
             report(tokens, position, RuntimeErrorTypeNoClosingParenthesis);
             return std::make_unique<Value>();
         }
-        std::vector<const Token*> insideParenthesis;
-        TokenSubArrayFinder::findSubArray(tokens, insideParenthesis, position+1, endPos-1);
         result = std::make_unique<Value>();
-        hadError = !execute(insideParenthesis, programState, argumentA, argumentB, *result);
+        hadError = !execute(tokens.subRange(position+1, endPos-1), programState, argumentA, argumentB, *result);
         position = endPos;
         return std::move(result);
     }
@@ -382,106 +1225,49 @@ std::unique_ptr<Value> Interpreter::getNextArgument(
     return std::move(result);
 }
     
+inline const Function& Interpreter::getFunction(const Token& function, ProgramState& programState)
+{
+    if(function.function != nullptr)
+        return *function.function;
+
+    return programState.functions[function.str];
+}
+
 bool Interpreter::getOperatorOrFunctionParamerters(const Token& operation,  bool& hasLeftParam, bool& hasRightParam, ProgramState& programState)
 {
     if(operation.id == TokenIdFunction){
-        const auto function = &programState.functions[operation.str];
-        hasLeftParam = function->hasLeft;
-        hasRightParam = function->hasRight;
+        const Function& function = getFunction(operation, programState);
+        hasLeftParam = function.hasLeft;
+        hasRightParam = function.hasRight;
         return true;
     }
     else 
         return OperatorArguments::getArgs(operation.id, hasLeftParam, hasRightParam);
 }
 
-std::unique_ptr<Value> Interpreter::executeOperationOrFunction(
+void Interpreter::executeOperationOrFunction(
     const Value& leftOfOperator,
     const Value& rightOfOperator,
     const Token& operation,
     const Value& argumentA,
     const Value& argumentB,
     ProgramState& programState,
+    Value& result,
     bool& hadError)
 {
-    switch (operation.id)
-    {
-    case TokenIdFunction:
-        {
-            auto result = std::make_unique<Value>();
-            hadError = !execute(programState.functions[operation.str].body, programState, leftOfOperator, rightOfOperator, *result);
-            return result;
-        }
-    case TokenIdAdd:
-        return InterpreterCalculator::add(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdSubtract:
-        return InterpreterCalculator::subtract(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdMultiply:
-        return InterpreterCalculator::multiply(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdDivide:
-        return InterpreterCalculator::divide(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdMod:
-        return InterpreterCalculator::mod(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdPower:
-        return InterpreterCalculator::power(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdIterate:
-        return InterpreterCalculator::iterate(leftOfOperator, hadError, errorReporter);
-    case TokenIdLogicalNot:
-        return InterpreterCalculator::logicalNot(leftOfOperator, hadError, errorReporter);
-    case TokenIdCount:
-        return InterpreterCalculator::count(leftOfOperator, hadError, errorReporter);
-    case TokenIdSumAll:
-        return InterpreterCalculator::sumAll(leftOfOperator, hadError, errorReporter);
-    case TokenIdMultiplyAll:
-        return InterpreterCalculator::multiplyAll(leftOfOperator, hadError, errorReporter);
-    case TokenIdLessThan:
-        return InterpreterCalculator::lessThan(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdGreaterThan:
-        return InterpreterCalculator::greaterThan(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdLessThanOrEquals:
-        return InterpreterCalculator::lessThanOrEquals(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdGreaterThanOrEquals:
-        return InterpreterCalculator::greaterThanOrEquals(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdIsEquals:
-        return InterpreterCalculator::equals(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdNotEquals:
-        return InterpreterCalculator::notEquals(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdUnion:
-        return InterpreterCalculator::findUnion(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdSelect:
-        return InterpreterCalculator::select(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdRandom:
-        return InterpreterCalculator::randomize(leftOfOperator, hadError, errorReporter);
-    case TokenIdSine:
-        return InterpreterCalculator::sine(leftOfOperator, hadError, errorReporter);
-    case TokenIdConvert:
-        return InterpreterCalculator::convert(leftOfOperator, hadError, errorReporter);
-    case TokenIdMakeSet:
-        return InterpreterCalculator::makeSet(leftOfOperator, hadError, errorReporter);
-    case TokenIdCeil:
-        return InterpreterCalculator::findCeil(leftOfOperator, hadError, errorReporter);
-    case TokenIdFloor:
-        return InterpreterCalculator::findFloor(leftOfOperator, hadError, errorReporter);
-    case TokenIdRound:
-        return InterpreterCalculator::findRound(leftOfOperator, hadError, errorReporter);
-    case TokenIdSort:
-        return InterpreterCalculator::sortArray(leftOfOperator, hadError, errorReporter);
-    case TokenIdReverse:
-        return InterpreterCalculator::reverseArray(leftOfOperator, hadError, errorReporter);
-    case TokenIdLeftRotate:
-        return InterpreterCalculator::leftRotate(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdRightRotate:
-        return InterpreterCalculator::rightRotate(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdRemove:
-        return InterpreterCalculator::remove(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdRemain:
-        return InterpreterCalculator::remain(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    case TokenIdCountEach:
-        return InterpreterCalculator::countEach(leftOfOperator, rightOfOperator, hadError, errorReporter);
-    default:
+    if(operation.id == TokenIdFunction){
+        // the parameters are used until the function returns
+        Value functionResult;
+        hadError = !callFunction(operation, programState, leftOfOperator, rightOfOperator, functionResult);
+        result = std::move(functionResult);
+        return;
+    }
+
+    if(!InterpreterCalculator::calculate(operation.id, leftOfOperator, rightOfOperator, result, hadError, getReporter())){
         hadError = true;
         report(RuntimeErrorTypeNotAnOperation);
 
-        return std::make_unique<Value>();
+        result.clear();
     }
 }
 
@@ -494,30 +1280,62 @@ bool Interpreter::isFunctionWithoutParameters(const Token& function, ProgramStat
     return (!hasLeft) && (!hasRight);
 }
 
-inline void Interpreter::setVariable(const Value& value, const std::string& variableName, ProgramState& programState)
+inline void Interpreter::setVariable(const Value& value, const Token& variable, ProgramState& programState)
 {
-    programState.variables[variableName].mut.lock();
-    programState.variables[variableName].value = value;
-    programState.variables[variableName].mut.unlock();
+    Variable& stored = programState.variables[variable.slot];
+    if(!programState.isConcurrent.load(std::memory_order_relaxed)){
+        stored.value = value;
+        stored.isDefined = true;
+        return;
+    }
+
+    ShardedLock& lock = programState.variableLocks[variable.slot % ProgramState::VARIABLE_LOCKS];
+    lock.lock();
+    stored.value = value;
+    stored.isDefined = true;
+    lock.unlock();
 }
     
-inline void Interpreter::getVariable(Value& value, const std::string& variableName, ProgramState& programState)
+inline bool Interpreter::getCountedNumber(const Token& token, ProgramState& programState, double& number)
 {
-    const auto variable = programState.variables.find(variableName);
-    if(variable == programState.variables.end()){
-        value = {0.0};
+    if(token.id == TokenIdLiteral){
+        number = token.val[0];
+        return true;
+    }
+
+    // an undefined variable reads as 0
+    const Variable& stored = programState.variables[token.slot];
+    if(programState.isConcurrent.load(std::memory_order_relaxed) || (stored.isDefined && stored.value.size() != 1))
+        return false;
+
+    number = stored.isDefined ? stored.value[0] : 0.0;
+    return true;
+}
+
+inline void Interpreter::getVariable(Value& value, const Token& variable, ProgramState& programState)
+{
+    Variable& stored = programState.variables[variable.slot];
+    if(!programState.isConcurrent.load(std::memory_order_relaxed)){
+        if(stored.isDefined)
+            value = stored.value;
+        else
+            value = {0.0};
         return;
     }
 
-    variable->second.mut.lock();
-    value = variable->second.value;
-    variable->second.mut.unlock();
+    ShardedLock& lock = programState.variableLocks[variable.slot % ProgramState::VARIABLE_LOCKS];
+    lock.lockShared();
+    if(stored.isDefined)
+        value = stored.value;
+    else
+        value = {0.0};
+    lock.unlockShared();
 }
 
 
 std::unique_ptr<Value> Interpreter::executeModifier(
     Value& leftParameter,
-    const std::vector<const Token*> &tokens,
+    const TokenRange& tokens,
     ProgramState& programState,
     const Value& argumentA,
     const Value& argumentB,
@@ -545,17 +1363,17 @@ std::unique_ptr<Value> Interpreter::executeModifier(
     }
 
     const Token* operation = tokens[position+1];
-    for(int i=0; i<size; i++){
-        Value first = {leftParameter[i]};
-        Value second = {(i+1>=size? 0.0:leftParameter[i+1])};
-
-        auto operationResult = executeOperationOrFunction(first, second, *operation, argumentA, argumentB, programState, hadError);
-        if(hadError){
-            report(tokens, position, RuntimeErrorTypeOperatorError);
-            return result;
-        }
-        for(const auto& j:*operationResult)
-            result->push_back(j);
+    if(!applyOperatorToEach(leftParameter, *operation, argumentA, argumentB, programState, *result, hadError)){
+        const int chunks = std::min(ThreadPool::getInstance().getSize(), size / PARALLEL_APPLY_SIZE);
+        std::unordered_set<const Function*> visited;
+        if(chunks > 1 && isPureFunction(*operation, visited))
+            applyToEachInParallel(leftParameter, chunks, *operation, argumentA, argumentB, programState, *result, hadError);
+        else
+            applyToEach(leftParameter, 0, size, *operation, argumentA, argumentB, programState, *result, hadError);
+    }
+    if(hadError){
+        report(tokens, position, RuntimeErrorTypeOperatorError);
+        return result;
     }
 
     if(result->size() == 0){
@@ -565,20 +1383,232 @@ std::unique_ptr<Value> Interpreter::executeModifier(
     return std::move(result);
 }
 
+int Interpreter::applyToEach(
+    const Value& values,
+    int begin,
+    int end,
+    const Token& operation,
+    const Value& argumentA,
+    const Value& argumentB,
+    ProgramState& programState,
+    Value& result,
+    bool& hadError)
+{
+    // the values are only read by index, so chunks can share them
+    const int size = values.size();
+    for(int i=begin; i<end; i++){
+        Value first = {values[i]};
+        Value second = {(i+1>=size? 0.0:values[i+1])};
+
+        executeOperationOrFunction(first, second, operation, argumentA, argumentB, programState, first, hadError);
+        if(hadError)
+            return i;
+        for(const auto& j:first)
+            result.push_back(j);
+    }
+    return end;
+}
+
+bool Interpreter::applyOperatorToEach(
+    const Value& values,
+    const Token& operation,
+    const Value& argumentA,
+    const Value& argumentB,
+    ProgramState& programState,
+    Value& result,
+    bool& hadError)
+{
+    // operators that can fail stay element by element, so only the first error is reported
+    switch(operation.id)
+    {
+    case TokenIdAdd:
+    case TokenIdSubtract:
+    case TokenIdMultiply:
+    case TokenIdLessThan:
+    case TokenIdGreaterThan:
+    case TokenIdLessThanOrEquals:
+    case TokenIdGreaterThanOrEquals:
+    case TokenIdIsEquals:
+    case TokenIdNotEquals:
+    {
+        Value neighbours;
+        InterpreterCalculator::shiftLeft(values, neighbours);
+        executeOperationOrFunction(values, neighbours, operation, argumentA, argumentB, programState, result, hadError);
+        return true;
+    }
+    case TokenIdLogicalNot:
+    case TokenIdSine:
+    case TokenIdCeil:
+    case TokenIdFloor:
+    case TokenIdRound:
+        executeOperationOrFunction(values, values, operation, argumentA, argumentB, programState, result, hadError);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Interpreter::applyToEachInParallel(
+    const Value& values,
+    int chunks,
+    const Token& operation,
+    const Value& argumentA,
+    const Value& argumentB,
+    ProgramState& programState,
+    Value& result,
+    bool& hadError)
+{
+    const int size = values.size();
+    std::vector<Value> results(chunks);
+    std::unique_ptr<bool[]> errors(new bool[chunks]());
+    std::vector<int> stops(chunks);
+    TaskGroup group;
+    for(int i=0; i<chunks; i++){
+        const int begin = (long long)size * i / chunks;
+        const int end = (long long)size * (i + 1) / chunks;
+        ThreadPool::getInstance().submit(group, [&, i, begin, end](){
+            // the errors of the chunks aren't reported, the first one is reported again by the calling thread
+            const bool wasReporting = isReportingErrors;
+            isReportingErrors = false;
+            stops[i] = applyToEach(values, begin, end, operation, argumentA, argumentB, programState, results[i], errors[i]);
+            isReportingErrors = wasReporting;
+        });
+    }
+    ThreadPool::getInstance().wait(group);
+
+    // the results up to the first failed element are kept like when the elements are applied in order
+    int last = 0;
+    size_t resultSize = 0;
+    for(; last<chunks; last++){
+        resultSize += results[last].size();
+        if(errors[last])
+            break;
+    }
+
+    result.reserve(resultSize);
+    for(int i=0; i<chunks && i<=last; i++){
+        for(size_t j=0; j<results[i].size(); j++)
+            result.push_back(results[i][j]);
+    }
+    if(last < chunks)
+        applyToEach(values, stops[last], stops[last] + 1, operation, argumentA, argumentB, programState, result, hadError);
+}
+
+bool Interpreter::isPureFunction(const Token& function, std::unordered_set<const Function*>& visited)
+{
+    // functions that aren't bound are looked up by name, which may add them to the program state
+    if(function.id != TokenIdFunction || function.function == nullptr)
+        return false;
+    if(!visited.insert(function.function).second)
+        return true;
+
+    for(const auto& i: function.function->body){
+        switch(i->id)
+        {
+        case TokenIdRead:
+        case TokenIdWrite:
+        case TokenIdReadText:
+        case TokenIdWriteText:
+        case TokenIdEquals:
+        case TokenIdRandom:
+        case TokenIdAsyncStart:
+        case TokenIdAsyncEnd:
+        case TokenIdAsyncJoin:
+            return false;
+        case TokenIdFunction:
+            if(!isPureFunction(*i, visited))
+                return false;
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+bool Interpreter::isMemoizable(const Function& function, std::unordered_set<const Function*>& visited)
+{
+    if(!visited.insert(&function).second)
+        return true;
+
+    for(const auto& i: function.body){
+        switch(i->id)
+        {
+        case TokenIdVariable:
+        case TokenIdRead:
+        case TokenIdWrite:
+        case TokenIdReadText:
+        case TokenIdWriteText:
+        case TokenIdEquals:
+        case TokenIdRandom:
+        case TokenIdApplyToEach:
+        case TokenIdAsyncStart:
+        case TokenIdAsyncEnd:
+        case TokenIdAsyncJoin:
+            return false;
+        case TokenIdFunction:
+            // functions that aren't bound are looked up by name, which may find a function defined later
+            if(i->function == nullptr || !isMemoizable(*i->function, visited))
+                return false;
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+void Interpreter::createMemoCaches(ProgramState& programState)
+{
+    // functions can be redefined between calls, so their results aren't kept
+    programState.memoCaches.clear();
+    if(!isMemoization)
+        return;
+
+    for(const auto& i: programState.functions){
+        std::unordered_set<const Function*> visited;
+        if(isMemoizable(i.second, visited)){
+            programState.memoCaches.emplace(std::piecewise_construct, std::forward_as_tuple(i.first),
+                std::forward_as_tuple(i.second.hasLeft, i.second.hasRight));
+        }
+    }
+}
+
+void Interpreter::setMemoCaches(ProgramState& programState)
+{
+    for(auto& i: programState.memoCaches){
+        const auto compiled = programState.compiledFunctions.find(i.first);
+        if(compiled != programState.compiledFunctions.end())
+            compiled->second.memoCache = &i.second;
+        const auto bytecode = programState.bytecodeFunctions.find(i.first);
+        if(bytecode != programState.bytecodeFunctions.end())
+            bytecode->second.memoCache = &i.second;
+    }
+}
+
+void Interpreter::collectMemoStatistics(ProgramState& programState)
+{
+    for(auto& i: programState.memoCaches){
+        const MemoStatistics statistics = i.second.getStatistics();
+        MemoStatistics& collected = memoStatistics[i.first];
+        collected.hits += statistics.hits;
+        collected.misses += statistics.misses;
+    }
+}
+
 bool Interpreter::executeAsync(
-    const std::vector<const Token*> &tokens,
+    const TokenRange& tokens,
     int& position,
     ProgramState& programState,
     const Value& argumentA,
     const Value& argumentB)
 {
-    std::vector<const Token*> toExecute;
-    int endPosition = TokenSubArrayFinder::findFirstTokenId(tokens, position, TokenIdAsyncEnd);
+    int endPosition = TokenSubArrayFinder::findJumpTarget(tokens, position);
     if(endPosition == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND)
         return false;
 
-    TokenSubArrayFinder::findSubArray(tokens, toExecute, position+1, endPosition-1);
-    programState.threads.push_back(std::thread(&Interpreter::executeOnThread, this, toExecute, std::ref(programState), argumentA, argumentB));
+    programState.isConcurrent = true;
+    ThreadPool::getInstance().submit(programState.tasks, std::bind(&Interpreter::executeOnThread, this, tokens.subRange(position+1, endPosition-1), std::ref(programState), argumentA, argumentB));
     position = endPosition;
 
     return true;
@@ -586,10 +1616,25 @@ bool Interpreter::executeAsync(
 
 void Interpreter::joinThreads(ProgramState& programState)
 {
-    for(auto& i: programState.threads)
-        i.join();
+    ThreadPool::getInstance().wait(programState.tasks);
+
+    // an async block that joins still runs itself
+    if(programState.tasks.pending.load(std::memory_order_acquire) == 0)
+        programState.isConcurrent = false;
+}
+
+void Interpreter::allocateVariables(const std::vector<const Token*>& tokens, ProgramState& programState)
+{
+    int slots = programState.variables.size();
+    for(const auto& i: tokens)
+        slots = std::max(slots, i->slot + 1);
+    for(const auto& i: programState.functions){
+        for(const auto& j: i.second.body)
+            slots = std::max(slots, j->slot + 1);
+    }
 
-    programState.threads.clear();
+    while((int)programState.variables.size() < slots)
+        programState.variables.emplace_back();
 }
 
 inline void Interpreter::endStatement(std::unique_ptr<Value>& lastResult, std::unique_ptr<Value>& leftParameter, std::unique_ptr<Value>& rightParameter)
@@ -633,13 +1678,13 @@ inline void Interpreter::writeText(ProgramState& programState, Value& value)
 
 void Interpreter::report(RuntimeErrorType errorType)
 {
-    if(errorReporter)
+    if(getReporter() != nullptr)
         errorReporter->report(errorType);
 }
 
-void Interpreter::report(const std::vector<const Token*> &tokens, int position, RuntimeErrorType errorType)
+void Interpreter::report(const TokenRange& tokens, int position, RuntimeErrorType errorType)
 {
-    if(errorReporter != nullptr && tokens.size() > 0)
+    if(getReporter() != nullptr && tokens.size() > 0)
         errorReporter->report(tokens, position, errorType);
 }
 
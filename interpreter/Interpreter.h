@@ -1,16 +1,23 @@
 #pragma once
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <stack>
 #include <thread>
+#include <atomic>
 #include "../token/Token.h"
+#include "../token/TokenRange.h"
 #include "RuntimeErrorType.h"
+#include "InterpreterEngine.h"
 #include "ProgramState.h"
+#include "MemoCache.h"
 #include "../scanner/Function.h"
+#include "../compiler/SyntaxTree.h"
+#include "../compiler/Bytecode.h"
 
 class IRuntimeErrorReporter{
 public:
-    virtual void report(const std::vector<const Token*>& tokens, int errorPosition, RuntimeErrorType errorType) = 0;
+    virtual void report(const TokenRange& tokens, int errorPosition, RuntimeErrorType errorType) = 0;
 
     virtual void report(RuntimeErrorType errorType) = 0;
 };
@@ -26,30 +33,154 @@ public:
     virtual void writeText(const Value& value) = 0;
 };
 
+struct Loop{
+    TokenRange condition;
+    int loopStart;
+    int loopEnd;
+};
+
+// state of the token interpreter in a block, compiled blocks hand it over when a value they rely on is empty
+struct ExecutionState{
+    std::unique_ptr<Value> leftParameter = std::make_unique<Value>();
+    std::unique_ptr<Value> rightParameter = std::make_unique<Value>();
+    std::unique_ptr<Value> lastResult = std::make_unique<Value>();
+    const Token* operation = nullptr;
+    std::stack<Loop> loopStack;
+};
+
+// state of a compiled block
+struct BlockEvaluation{
+    const SyntaxBlock& block;
+    ProgramState& programState;
+    const Value& argumentA;
+    const Value& argumentB;
+    std::unique_ptr<Value> lastResult;
+    // loops the current statement is in (outermost first)
+    std::vector<const SyntaxNode*> loops;
+    // set when the rest of the block was executed by the token interpreter
+    bool isHandedOver;
+    bool handOverSucceeded;
+};
+
 class Interpreter{
 public:
-    Interpreter(IRuntimeErrorReporter* errorReporter, IInterpreterIO* interpreterIO);
+    Interpreter(IRuntimeErrorReporter* errorReporter, IInterpreterIO* interpreterIO, InterpreterEngine engine = InterpreterEngineTokens);
 
     bool execute(const std::vector<const Token*> &tokens, const std::unordered_map<std::string, Function>& functions, Value& result);
 
     bool execute(const std::vector<const Token*> &tokens, ProgramState& programState, Value& result);
 
+    // memoization is off by default, it applies to programs executed afterwards
+    static void setMemoization(bool isEnabled);
+
+    // hits and misses of the memoized functions in the programs executed so far, by name
+    const std::unordered_map<std::string, MemoStatistics>& getMemoStatistics() const { return memoStatistics; }
+
+#ifdef INTERPRETER_COUNT_INSTRUCTIONS
+    // bytecode instructions dispatched since construction
+    unsigned long long getExecutedInstructions() const { return executedInstructions; }
+#endif
+
 private:
     bool execute(
-        const std::vector<const Token*> &tokens,
+        const TokenRange& tokens,
+        ProgramState& programState,
+        const Value& argumentA,
+        const Value& argumentB,
+        Value& result);
+
+    // continues the block from start with the given state
+    bool execute(
+        const TokenRange& tokens,
+        int start,
+        ProgramState& programState,
+        const Value& argumentA,
+        const Value& argumentB,
+        ExecutionState& state,
+        Value& result);
+
+    bool evaluate(
+        const SyntaxBlock& block,
+        ProgramState& programState,
+        const Value& argumentA,
+        const Value& argumentB,
+        Value& result);
+
+    // return false on error or when the block was handed over to the token interpreter
+    bool evaluateStatements(const std::vector<SyntaxNode>& statements, BlockEvaluation& evaluation);
+
+    bool evaluateStatement(const SyntaxNode& statement, BlockEvaluation& evaluation);
+
+    // hands the block over if the result is empty
+    bool evaluateExpression(const SyntaxNode& expression, BlockEvaluation& evaluation, std::unique_ptr<Value>& result);
+
+    bool evaluateNode(const SyntaxNode& node, BlockEvaluation& evaluation, std::unique_ptr<Value>& result);
+
+    // the token interpreter continues after position with the given left parameter, right parameter and operation
+    void handOver(
+        BlockEvaluation& evaluation,
+        int position,
+        std::unique_ptr<Value> leftParameter,
+        std::unique_ptr<Value> rightParameter,
+        const Token* operation);
+
+    void evaluateOnThread(
+        const SyntaxBlock* block,
+        ProgramState& programState,
+        const Value argumentA,
+        const Value argumentB);
+
+    bool run(
+        const BytecodeBlock& block,
+        ProgramState& programState,
+        const Value& argumentA,
+        const Value& argumentB,
+        Value& result);
+
+    // replaces value with the result of the fused expression on it, false if it has to be calculated by its operators
+    bool evaluateFused(
+        const FusedExpression& fused,
+        const Value& argumentA,
+        const Value& argumentB,
+        ProgramState& programState,
+        Value& value);
+
+    void runOnThread(
+        const BytecodeBlock* block,
+        ProgramState& programState,
+        const Value argumentA,
+        const Value argumentB);
+
+    bool callFunction(
+        const Token& function,
+        ProgramState& programState,
+        const Value& argumentA,
+        const Value& argumentB,
+        Value& result);
+
+    // calls memoized functions through their caches
+    bool callCompiled(
+        const BytecodeBlock& function,
+        ProgramState& programState,
+        const Value& argumentA,
+        const Value& argumentB,
+        Value& result);
+
+    bool callCompiled(
+        const SyntaxBlock& function,
         ProgramState& programState,
         const Value& argumentA,
         const Value& argumentB,
         Value& result);
 
     void executeOnThread(
-        const std::vector<const Token*> tokens,
+        TokenRange tokens,
         ProgramState& programState,
         const Value argumentA,
         const Value argumentB);
 
     inline bool checkForCalculation(
-        const std::vector<const Token*> &tokens,
+        const TokenRange& tokens,
         int& position,
         ProgramState& programState,
         const Value& argumentA,
@@ -60,7 +191,7 @@ private:
 
     inline bool getArgumentsAndOperation(
         int& position,
-        const std::vector<const Token*> &tokens,
+        const TokenRange& tokens,
         ProgramState& programState,
         std::unique_ptr<Value>& leftParameter,
         std::unique_ptr<Value>& rightParameter,
@@ -70,7 +201,7 @@ private:
 
     std::unique_ptr<Value> getNextArgument(
         int& position,
-        const std::vector<const Token*> &tokens,
+        const TokenRange& tokens,
         ProgramState& programState,
         const Value& argumentA,
         const Value& argumentB,
@@ -78,7 +209,7 @@ private:
 
     //returns statement end position
     int executeStatement(
-        const std::vector<const Token*> &tokens,
+        const TokenRange& tokens,
         int position,
         ProgramState& programState,
         const Value& argumentA,
@@ -87,21 +218,26 @@ private:
         bool& hadError);
 
     // returns false if not an operation
+    // the function a function token is bound to, looked up by name if it isn't bound
+    inline const Function& getFunction(const Token& function, ProgramState& programState);
+
     bool getOperatorOrFunctionParamerters(const Token& operation, bool& hasLeftParam, bool& hasRightParam, ProgramState& programState);
 
-    std::unique_ptr<Value> executeOperationOrFunction(
+    // result may be one of the operands, it is reused for the result of operators
+    void executeOperationOrFunction(
         const Value& leftOfOperator,
         const Value& rightOfOperator,
         const Token& operation,
         const Value& argumentA,
         const Value& argumentB,
         ProgramState& programState,
+        Value& result,
         bool& hadError);
 
     bool isFunctionWithoutParameters(const Token& function, ProgramState& programState);
 
     bool executeAsync(
-        const std::vector<const Token*> &tokens,
+        const TokenRange& tokens,
         int& position,
         ProgramState& programState,
         const Value& argumentA,
@@ -109,22 +245,80 @@ private:
 
     inline std::unique_ptr<Value> executeModifier(
         Value& leftParameter,
-        const std::vector<const Token*> &tokens,
+        const TokenRange& tokens,
         ProgramState& programState,
         const Value& argumentA,
         const Value& argumentB,
         int position,
         bool& hadError);
 
-    inline void setVariable(const Value& value, const std::string& variableName, ProgramState& programState);
+    // appends the results of the operation on the elements from begin to end, each element is paired with the next one,
+    // returns the index of the element that failed or end
+    int applyToEach(
+        const Value& values,
+        int begin,
+        int end,
+        const Token& operation,
+        const Value& argumentA,
+        const Value& argumentB,
+        ProgramState& programState,
+        Value& result,
+        bool& hadError);
+
+    // runs an element wise built-in operator once over the whole array and its neighbours, false for other operations
+    bool applyOperatorToEach(
+        const Value& values,
+        const Token& operation,
+        const Value& argumentA,
+        const Value& argumentB,
+        ProgramState& programState,
+        Value& result,
+        bool& hadError);
+
+    // splits the elements into chunks that run on the thread pool, the results are concatenated in order
+    void applyToEachInParallel(
+        const Value& values,
+        int chunks,
+        const Token& operation,
+        const Value& argumentA,
+        const Value& argumentB,
+        ProgramState& programState,
+        Value& result,
+        bool& hadError);
+
+    // a pure function doesn't read, write, assign variables, draw random numbers or run async blocks, nor do the functions it calls
+    bool isPureFunction(const Token& function, std::unordered_set<const Function*>& visited);
+
+    // a memoizable function is pure and reads no variables, nor do the functions it calls, so its result only depends
+    // on its parameters, apply to each is left out since it reports errors and continues
+    bool isMemoizable(const Function& function, std::unordered_set<const Function*>& visited);
+
+    // caches for the memoizable functions of the program
+    void createMemoCaches(ProgramState& programState);
+
+    // the compiled functions of the caches call through them
+    void setMemoCaches(ProgramState& programState);
+
+    void collectMemoStatistics(ProgramState& programState);
+
+    inline void setVariable(const Value& value, const Token& variable, ProgramState& programState);
     
-    inline void getVariable(Value& value, const std::string& variableName, ProgramState& programState);
+    inline void getVariable(Value& value, const Token& variable, ProgramState& programState);
+
+    // the number of a literal or a variable of a counted loop, false if it isn't one number or is concurrent
+    inline bool getCountedNumber(const Token& token, ProgramState& programState, double& number);
+
+    // makes room for the slots of the variables of the program and its functions
+    void allocateVariables(const std::vector<const Token*>& tokens, ProgramState& programState);
 
     void joinThreads(ProgramState& programState);
     
+    // null while the thread runs a chunk of apply to each whose errors aren't reported
+    IRuntimeErrorReporter* getReporter() const { return isReportingErrors ? errorReporter : nullptr; }
+
     void report(RuntimeErrorType errorType);
 
-    void report(const std::vector<const Token*> &tokens, int position, RuntimeErrorType errorType);
+    void report(const TokenRange& tokens, int position, RuntimeErrorType errorType);
 
     inline void endStatement(std::unique_ptr<Value>& lastResult, std::unique_ptr<Value>& leftParameter, std::unique_ptr<Value>& rightParameter);
 
@@ -139,4 +333,17 @@ private:
 private:
     IRuntimeErrorReporter* errorReporter;
     IInterpreterIO* interpreterIO;
+    InterpreterEngine engine;
+    std::unordered_map<std::string, MemoStatistics> memoStatistics;
+#ifdef INTERPRETER_COUNT_INSTRUCTIONS
+    std::atomic<unsigned long long> executedInstructions;
+#endif
+
+    // values on the bytecode stack before it grows, expressions rarely nest deeper
+    static const int INITIAL_STACK_CAPACITY = 8;
+    // elements per chunk below which apply to each with a pure function stays on the calling thread
+    static const int PARALLEL_APPLY_SIZE = 1024;
+
+    static bool isMemoization;
+    static thread_local bool isReportingErrors;
 };
\ No newline at end of file
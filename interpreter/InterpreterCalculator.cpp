@@ -1,9 +1,27 @@
 #include "InterpreterCalculator.h"
+#include "ArrayKernels.h"
+#include "ArraySort.h"
+#include "NumberTable.h"
 #include "../util/RandomGenerator.h"
 #include "../util/StringUtil.h"
+#include <cfloat>
 #include <cmath>
-#include <unordered_set>
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+
+bool InterpreterCalculator::isCompensatedSum = false;
+int InterpreterCalculator::reductionTasks = 0;
+
+void InterpreterCalculator::setCompensatedSum(bool isCompensated)
+{
+    isCompensatedSum = isCompensated;
+}
+
+void InterpreterCalculator::setReductionTasks(int tasks)
+{
+    reductionTasks = tasks;
+}
 
 bool InterpreterCalculator::validateInput(const Value& input, IRuntimeErrorReporter* reporter, bool& hadError)
 {
@@ -17,531 +35,1384 @@ bool InterpreterCalculator::validateInput(const Value& input, IRuntimeErrorRepor
     return true;
 }
 
-std::unique_ptr<Value> InterpreterCalculator::dyadicFunction(
+Value& InterpreterCalculator::getDestination(const Value& left, const Value& right, Value& result, size_t size, Value& output)
+{
+    // a range has no numbers to reuse
+    if(!result.isRange() && ((&result == &left && left.size() == size) || (&result == &right && right.size() == size)))
+        return result;
+
+    output.resize(size);
+    return output;
+}
+
+void InterpreterCalculator::dyadicFunction(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter,
         DyadicFunctionLambda lambda
     )
 {
-    auto result = std::make_unique<Value>();
     const int leftSize = left.size();
     const int rightSize = right.size();
     if((!validateInput(left, reporter, hadError)) || (!validateInput(right, reporter, hadError))){
         hadError = true;
         if(reporter)
             reporter->report(RuntimeErrorTypeEmptyData);
-        
-        return std::move(result);
+
+        result.clear();
+        return;
     }
 
     const int maxSize = std::max(leftSize, rightSize);
-    result->reserve(maxSize);
+    Value output;
+    Value& destination = getDestination(left, right, result, maxSize, output);
+
+    // the parameters are read after the destination is made unique, it may be one of them
+    double* numbers = destination.mutableData();
+    if(left.isRange() || right.isRange() || left.type() != ValueTypeNumber || right.type() != ValueTypeNumber){
+        // numbers of ranges are calculated instead of stored, bytes are promoted one by one
+        for(int i=0; i<maxSize; i++){
+            numbers[i] = lambda(left[i%leftSize], right[i%rightSize], hadError, reporter);
+        }
+    }else{
+        const double* leftNumbers = left.data();
+        const double* rightNumbers = right.data();
+        for(int i=0; i<maxSize; i++){
+            numbers[i] = lambda(leftNumbers[i%leftSize], rightNumbers[i%rightSize], hadError, reporter);
+        }
+    }
+
+    if(&destination == &output)
+        result = std::move(output);
+}
+
+bool InterpreterCalculator::areStoredNumbers(const Value& left, const Value& right)
+{
+    return !left.empty() && !right.empty() && !left.isRange() && !right.isRange() &&
+        left.type() == ValueTypeNumber && right.type() == ValueTypeNumber;
+}
+
+void InterpreterCalculator::calculateNumbers(const Value& left, const Value& right, Value& result, ArrayOperation operation)
+{
+    const size_t size = std::max(left.size(), right.size());
+    Value output;
+    Value& destination = getDestination(left, right, result, size, output);
+
+    // the parameters are read after the destination is made unique, it may be one of them
+    double* numbers = destination.mutableData();
+    ArrayKernels::calculate(operation, left.data(), left.size(), right.data(), right.size(), numbers, size);
+
+    if(&destination == &output)
+        result = std::move(output);
+}
 
-    for(int i=0; i<maxSize; i++){
-        result->push_back(lambda(left[i%leftSize],right[i%rightSize], hadError, reporter));
+template<typename Comparison>
+void InterpreterCalculator::compare(
+        const Value& left,
+        const Value& right,
+        Value& result,
+        bool& hadError,
+        IRuntimeErrorReporter* reporter,
+        ArrayComparison kernel,
+        Comparison comparison
+    )
+{
+    const int leftSize = left.size();
+    const int rightSize = right.size();
+    const int maxSize = std::max(leftSize, rightSize);
+    if(leftSize == 0 || rightSize == 0 || maxSize <= (int)Value::INLINE_CAPACITY){
+        dyadicFunction(left, right, result, hadError, reporter,
+            [comparison](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double
+        {
+            return comparison(a, b) ? 1.0 : 0.0;
+        });
+        return;
     }
 
-    return std::move(result);
+    Value output = Value::makeBytes(ValueTypeBoolean, maxSize);
+    unsigned char* flags = output.mutableBytes();
+    if((rightSize == 1 && left.type() != ValueTypeNumber) || (leftSize == 1 && right.type() != ValueTypeNumber)){
+        // every byte value is compared once
+        const bool isBytesLeft = rightSize == 1;
+        const Value& bytesValue = isBytesLeft ? left : right;
+        const double scalar = isBytesLeft ? right[0] : left[0];
+        bool outcomes[BYTE_VALUES];
+        for(int i=0; i<BYTE_VALUES; i++){
+            const double number = Value::byteToNumber(bytesValue.type(), (unsigned char)i);
+            outcomes[i] = isBytesLeft ? comparison(number, scalar) : comparison(scalar, number);
+        }
+
+        const unsigned char* bytes = bytesValue.bytes();
+        for(int i=0; i<maxSize; i++)
+            flags[i] = outcomes[bytes[i]];
+    }else if(areStoredNumbers(left, right)){
+        ArrayKernels::compare(kernel, left.data(), leftSize, right.data(), rightSize, flags, maxSize);
+    }else{
+        for(int i=0; i<maxSize; i++)
+            flags[i] = comparison(left[i%leftSize], right[i%rightSize]);
+    }
+
+    result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::add(
+bool InterpreterCalculator::getRangeAndScalar(const Value& left, const Value& right, const Value*& range, double& scalar, bool& isRangeLeft)
+{
+    if(left.isRange() && right.size() == 1){
+        range = &left;
+        scalar = right[0];
+        isRangeLeft = true;
+        return true;
+    }
+    if(right.isRange() && left.size() == 1){
+        range = &right;
+        scalar = left[0];
+        isRangeLeft = false;
+        return true;
+    }
+    return false;
+}
+
+bool InterpreterCalculator::isExactInteger(double number)
+{
+    return number == floor(number) && fabs(number) <= MAX_EXACT_INTEGER;
+}
+
+bool InterpreterCalculator::transformRange(const Value& range, double offset, double factor, Value& result)
+{
+    // every number of the range and the result must be an exact integer,
+    // so the numbers are the same as when they are calculated one by one
+    const double start = offset + factor * range.rangeStart();
+    const double step = factor * range.rangeStep();
+    const double last = start + (range.size() - 1) * step;
+    if(factor == 0.0 || !isExactInteger(offset) || !isExactInteger(factor) || !isExactInteger(range.rangeStart()) ||
+        !isExactInteger(range.rangeStep()) || !isExactInteger(start) || !isExactInteger(step) ||
+        !isExactInteger((range.size() - 1) * step) || !isExactInteger(last))
+        return false;
+
+    // a negative factor turns 0 into -0
+    const double rangeLast = range.back();
+    if(factor < 0.0 && std::min(range.rangeStart(), rangeLast) <= 0.0 && std::max(range.rangeStart(), rangeLast) >= 0.0)
+        return false;
+
+    result = Value::makeRange(start, step, range.size());
+    return true;
+}
+
+bool InterpreterCalculator::calculate(
+    TokenId operation,
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a + b;
-        })
-    );
+    switch (operation)
+    {
+    case TokenIdAdd:
+        add(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdSubtract:
+        subtract(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdMultiply:
+        multiply(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdDivide:
+        divide(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdMod:
+        mod(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdPower:
+        power(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdIterate:
+        iterate(left, result, hadError, reporter);
+        return true;
+    case TokenIdLogicalNot:
+        logicalNot(left, result, hadError, reporter);
+        return true;
+    case TokenIdCount:
+        count(left, result, hadError, reporter);
+        return true;
+    case TokenIdSumAll:
+        sumAll(left, result, hadError, reporter);
+        return true;
+    case TokenIdMultiplyAll:
+        multiplyAll(left, result, hadError, reporter);
+        return true;
+    case TokenIdLessThan:
+        lessThan(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdGreaterThan:
+        greaterThan(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdLessThanOrEquals:
+        lessThanOrEquals(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdGreaterThanOrEquals:
+        greaterThanOrEquals(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdIsEquals:
+        equals(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdNotEquals:
+        notEquals(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdUnion:
+        findUnion(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdSelect:
+        select(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdRandom:
+        randomize(left, result, hadError, reporter);
+        return true;
+    case TokenIdSine:
+        sine(left, result, hadError, reporter);
+        return true;
+    case TokenIdConvert:
+        convert(left, result, hadError, reporter);
+        return true;
+    case TokenIdMakeSet:
+        makeSet(left, result, hadError, reporter);
+        return true;
+    case TokenIdCeil:
+        findCeil(left, result, hadError, reporter);
+        return true;
+    case TokenIdFloor:
+        findFloor(left, result, hadError, reporter);
+        return true;
+    case TokenIdRound:
+        findRound(left, result, hadError, reporter);
+        return true;
+    case TokenIdSort:
+        sortArray(left, result, hadError, reporter);
+        return true;
+    case TokenIdReverse:
+        reverseArray(left, result, hadError, reporter);
+        return true;
+    case TokenIdLeftRotate:
+        leftRotate(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdRightRotate:
+        rightRotate(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdRemove:
+        remove(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdRemain:
+        remain(left, right, result, hadError, reporter);
+        return true;
+    case TokenIdCountEach:
+        countEach(left, right, result, hadError, reporter);
+        return true;
+    default:
+        return false;
+    }
 }
 
-
-std::unique_ptr<Value> InterpreterCalculator::subtract(
+void InterpreterCalculator::add(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a - b;
-        })
-    );
+    const Value* range;
+    double scalar;
+    bool isRangeLeft;
+    if(getRangeAndScalar(left, right, range, scalar, isRangeLeft) && transformRange(*range, scalar, 1.0, result))
+        return;
+    if(areStoredNumbers(left, right)){
+        calculateNumbers(left, right, result, ArrayOperationAdd);
+        return;
+    }
+
+    dyadicFunction(left, right, result, hadError, reporter,
+        [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double
+    {
+        return a + b;
+    });
 }
 
 
-std::unique_ptr<Value> InterpreterCalculator::multiply(
+void InterpreterCalculator::subtract(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a * b;
-        })
-    );
+    const Value* range;
+    double scalar;
+    bool isRangeLeft;
+    if(getRangeAndScalar(left, right, range, scalar, isRangeLeft) &&
+        transformRange(*range, isRangeLeft ? -scalar : scalar, isRangeLeft ? 1.0 : -1.0, result))
+        return;
+    if(areStoredNumbers(left, right)){
+        calculateNumbers(left, right, result, ArrayOperationSubtract);
+        return;
+    }
+
+    dyadicFunction(left, right, result, hadError, reporter,
+        [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double
+    {
+        return a - b;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::divide(
+void InterpreterCalculator::multiply(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            if(b == 0){
-                if(r)
-                    r->report(RuntimeErrorTypeDivisionByZero);
-                err = true;
-                return 0.0;
-            }
-            return a / b;
-        })
-    );
+    const Value* range;
+    double scalar;
+    bool isRangeLeft;
+    if(getRangeAndScalar(left, right, range, scalar, isRangeLeft) && transformRange(*range, 0.0, scalar, result))
+        return;
+    if(areStoredNumbers(left, right)){
+        calculateNumbers(left, right, result, ArrayOperationMultiply);
+        return;
+    }
+
+    dyadicFunction(left, right, result, hadError, reporter,
+        [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double
+    {
+        return a * b;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::mod(
+void InterpreterCalculator::divide(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            const long long llA = a;
-            const long long llB = b;
-            if(llB == 0){
-                if(r)
-                    r->report(RuntimeErrorTypeDivisionByZero);
-                err = true;
-                return 0.0;
-            }
-            return (double)(llA % llB);
-        })
-    );
+    // divisors are checked in one pass, the element wise calculation reports the divisions by zero
+    if(areStoredNumbers(left, right) && !ArrayKernels::hasZero(right.data(), right.size(), false)){
+        calculateNumbers(left, right, result, ArrayOperationDivide);
+        return;
+    }
+
+    dyadicFunction(left, right, result, hadError, reporter,
+        [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double
+    {
+        if(b == 0){
+            if(r)
+                r->report(RuntimeErrorTypeDivisionByZero);
+            err = true;
+            return 0.0;
+        }
+        return a / b;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::lessThan(
+void InterpreterCalculator::mod(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a < b? 1.0 : 0.0;
-        })
-    );
+    if(areStoredNumbers(left, right) && !ArrayKernels::hasZero(right.data(), right.size(), true)){
+        calculateNumbers(left, right, result, ArrayOperationMod);
+        return;
+    }
+
+    dyadicFunction(left, right, result, hadError, reporter,
+        [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double
+    {
+        const long long llA = a;
+        const long long llB = b;
+        if(llB == 0){
+            if(r)
+                r->report(RuntimeErrorTypeDivisionByZero);
+            err = true;
+            return 0.0;
+        }
+        return (double)(llA % llB);
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::greaterThan(
+void InterpreterCalculator::lessThan(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a > b? 1.0 : 0.0;
-        })
-    );
+    compare(left, right, result, hadError, reporter, ArrayComparisonLessThan,
+        [](double a, double b) -> bool
+    {
+        return a < b;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::lessThanOrEquals(
+void InterpreterCalculator::greaterThan(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a <= b? 1.0 : 0.0;
-        })
-    );
+    compare(left, right, result, hadError, reporter, ArrayComparisonGreaterThan,
+        [](double a, double b) -> bool
+    {
+        return a > b;
+    });
+}
+
+void InterpreterCalculator::lessThanOrEquals(
+    const Value& left,
+    const Value& right,
+    Value& result,
+    bool& hadError,
+    IRuntimeErrorReporter* reporter)
+{
+    compare(left, right, result, hadError, reporter, ArrayComparisonLessThanOrEquals,
+        [](double a, double b) -> bool
+    {
+        return a <= b;
+    });
 }
 
 
-std::unique_ptr<Value> InterpreterCalculator::greaterThanOrEquals(
+void InterpreterCalculator::greaterThanOrEquals(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a >= b? 1.0 : 0.0;
-        })
-    );
+    compare(left, right, result, hadError, reporter, ArrayComparisonGreaterThanOrEquals,
+        [](double a, double b) -> bool
+    {
+        return a >= b;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::equals(
+void InterpreterCalculator::equals(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a == b? 1.0 : 0.0;
-        })
-    );
+    compare(left, right, result, hadError, reporter, ArrayComparisonEquals,
+        [](double a, double b) -> bool
+    {
+        return a == b;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::notEquals(
+void InterpreterCalculator::notEquals(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            return a != b? 1.0 : 0.0;
-        })
-    );
+    compare(left, right, result, hadError, reporter, ArrayComparisonNotEquals,
+        [](double a, double b) -> bool
+    {
+        return a != b;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::power(
+void InterpreterCalculator::power(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    return std::move(
-        dyadicFunction(left, right, hadError, reporter,
-            [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double 
-        {
-            if(a == 0.0 && b == 0.0){
-                if(r)
-                    r->report(RuntimeErrorTypeZeroPowerZero);
-                err = true;
-                return 0.0;
-            }
-            double res = pow(a, b);
-            if(std::isnan(res)){
-                if(r)
-                    r->report(RuntimeErrorTypeArithmetic);
-                err = true;
-                return 0.0;
-            }
-            return res;
-        })
-    );
+    // the result is checked for NaN after the calculation, which may be redone element wise to report the error,
+    // so it doesn't overwrite the parameters
+    if(areStoredNumbers(left, right) &&
+        !(ArrayKernels::hasZero(left.data(), left.size(), false) && ArrayKernels::hasZero(right.data(), right.size(), false))){
+        Value output;
+        calculateNumbers(left, right, output, ArrayOperationPower);
+        if(!ArrayKernels::hasNaN(output.data(), output.size())){
+            result = std::move(output);
+            return;
+        }
+    }
+
+    dyadicFunction(left, right, result, hadError, reporter,
+        [](double a, double b, bool& err, IRuntimeErrorReporter* r) -> double
+    {
+        if(a == 0.0 && b == 0.0){
+            if(r)
+                r->report(RuntimeErrorTypeZeroPowerZero);
+            err = true;
+            return 0.0;
+        }
+        double res = pow(a, b);
+        if(std::isnan(res)){
+            if(r)
+                r->report(RuntimeErrorTypeArithmetic);
+            err = true;
+            return 0.0;
+        }
+        return res;
+    });
 }
 
-std::unique_ptr<Value> InterpreterCalculator::sine(
+void InterpreterCalculator::sine(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    result->reserve(left.size());
-    for(const auto& i: left)
-        result->push_back(sin(i));
-    
-    return std::move(result);
+    const int size = left.size();
+    Value output;
+    Value& destination = getDestination(left, left, result, size, output);
+    double* numbers = destination.mutableData();
+    const double* leftNumbers = left.data();
+    for(int i=0; i<size; i++)
+        numbers[i] = sin(leftNumbers[i]);
+
+    if(&destination == &output)
+        result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::convert(
+void InterpreterCalculator::convert(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
     std::string converted;
     StringUtil::convertValueToString(left, converted);
-    for(const auto& i: converted)
-        result->push_back((char)i);
-    
-    return std::move(result);
+    result = Value::makeCharacters(converted.data(), converted.size());
 }
 
-std::unique_ptr<Value> InterpreterCalculator::iterate(
+void InterpreterCalculator::iterate(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
+
+    // 1..N is kept as a range
+    if(left.size() == 1 && floor(left[0]) >= 1.0 && floor(left[0]) <= MAX_EXACT_INTEGER){
+        result = Value::makeRange(1.0, 1.0, (size_t)floor(left[0]));
+        return;
+    }
 
-    result->reserve((size_t)std::max(left[0], 1.0)); // assume only one element
+    Value output;
+    output.reserve((size_t)std::max(left[0], 1.0)); // assume only one element
     for(const auto& i: left){
         int val = floor(i);
         if(val <= 0)
             continue;
 
         for(int j = 1; j <= val; j++){
-            result->push_back((double)j);
+            output.push_back((double)j);
         }
     }
-    if(result->size() == 0)
-        result->push_back(0.0);
+    if(output.size() == 0)
+        output.push_back(0.0);
 
-    return std::move(result);
+    result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::logicalNot(
+void InterpreterCalculator::logicalNot(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
-    
-    result->reserve(left.size());
-    for(const auto& i:left)
-        result->push_back(i == 0.0 ? 1.0 : 0.0);
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    return std::move(result);
+    const int size = left.size();
+    if(size > (int)Value::INLINE_CAPACITY){
+        Value output = Value::makeBytes(ValueTypeBoolean, size);
+        unsigned char* flags = output.mutableBytes();
+        if(left.type() != ValueTypeNumber){
+            const unsigned char* bytes = left.bytes();
+            for(int i=0; i<size; i++)
+                flags[i] = Value::byteToNumber(left.type(), bytes[i]) == 0.0;
+        }else{
+            const double* leftNumbers = left.data();
+            for(int i=0; i<size; i++)
+                flags[i] = leftNumbers[i] == 0.0;
+        }
+
+        result = std::move(output);
+        return;
+    }
+
+    Value output;
+    Value& destination = getDestination(left, left, result, size, output);
+    double* numbers = destination.mutableData();
+    const double* leftNumbers = left.data();
+    for(int i=0; i<size; i++)
+        numbers[i] = leftNumbers[i] == 0.0 ? 1.0 : 0.0;
+
+    if(&destination == &output)
+        result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::count(
+void InterpreterCalculator::count(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
     const int size = left.size();
     if(size == 0){
         hadError = true;
         if(reporter)
             reporter->report(RuntimeErrorTypeEmptyData);
 
-        return result;
+        result.clear();
+        return;
     }
-    result->push_back((double)size);
 
-    return std::move(result);
+    result = {(double)size};
 }
 
-std::unique_ptr<Value> InterpreterCalculator::sumAll(
+void InterpreterCalculator::sumAll(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
-    
-    double sum = 0.0;
-    for(const auto& i: left)
-        sum += i;
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
+
+    if(left.isRange()){
+        // n * start + step * n(n-1)/2
+        const long double size = left.size();
+        result = {(double)(size * left.rangeStart() + left.rangeStep() * (size * (size - 1) / 2))};
+        return;
+    }
 
-    result->push_back(sum);
+    const size_t size = left.size();
+    std::vector<double> partials;
+    if(left.type() != ValueTypeNumber){
+        // bytes are summed without widening them
+        const unsigned char* bytes = left.bytes();
+        const bool isCharacter = left.type() == ValueTypeCharacter;
+        if(size <= REDUCTION_BLOCK){
+            result = {(double)ArrayKernels::sumBytes(bytes, size, isCharacter)};
+            return;
+        }
+        reduceBlocks(size, [bytes, isCharacter](size_t begin, size_t end){
+            return (double)ArrayKernels::sumBytes(bytes + begin, end - begin, isCharacter);
+        }, partials);
+        result = {ArrayKernels::sum(partials.data(), partials.size())};
+        return;
+    }
+
+    // only arrays that are reduced on the thread pool are added in lanes, smaller ones are added in order
+    const double* numbers = left.data();
+    double sum = 0.0;
+    double compensation = 0.0;
+    if(isCompensatedSum){
+        if(size < PARALLEL_REDUCTION_SIZE){
+            result = {ArrayKernels::compensatedSum(numbers, size, sum, compensation)};
+            return;
+        }
+        reduceBlocks(size, [numbers](size_t begin, size_t end){
+            return ArrayKernels::compensatedSumInLanes(numbers + begin, end - begin);
+        }, partials);
+        result = {ArrayKernels::compensatedSum(partials.data(), partials.size(), sum, compensation)};
+        return;
+    }
 
-    return std::move(result);
+    if(size < PARALLEL_REDUCTION_SIZE){
+        result = {ArrayKernels::sum(numbers, size)};
+        return;
+    }
+    reduceBlocks(size, [numbers](size_t begin, size_t end){
+        return ArrayKernels::sumInLanes(numbers + begin, end - begin);
+    }, partials);
+    result = {ArrayKernels::sum(partials.data(), partials.size())};
 }
 
-std::unique_ptr<Value> InterpreterCalculator::multiplyAll(
+void InterpreterCalculator::multiplyAll(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
-    
-    double prod = 1.0;
-    for(const auto& i: left)
-        prod *= i;
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
+
+    const double* numbers = left.data();
+    double product;
+    multiplyBlocks(left.size(), [numbers](size_t begin, size_t){ return numbers + begin; }, product);
+    result = {product};
+}
+
+bool InterpreterCalculator::calculateFused(const FusedExpression& expression, const std::vector<const Value*>& operands, Value& result)
+{
+    size_t size = 0;
+    for(const auto operand: operands)
+        size = std::max(size, operand->size());
+    if(size < FUSED_SIZE)
+        return false;
+
+    // a single operator on characters or booleans looks their bytes up, which is faster than promoting them
+    const bool isSingleOperator = operands.size() == 2;
+
+    // repeating shorter arrays would repeat the intermediate results instead of the operands
+    std::vector<FusedOperand> fusedOperands;
+    fusedOperands.reserve(operands.size());
+    for(const auto operand: operands){
+        if(operand->isRange() || (operand->size() != 1 && operand->size() != size))
+            return false;
+        if(isSingleOperator && operand->size() == size && operand->type() != ValueTypeNumber)
+            return false;
+
+        FusedOperand fusedOperand;
+        fusedOperand.type = operand->type();
+        fusedOperand.size = operand->size();
+        fusedOperand.numbers = fusedOperand.type == ValueTypeNumber ? operand->data() : nullptr;
+        fusedOperand.bytes = fusedOperand.type == ValueTypeNumber ? nullptr : operand->bytes();
+        fusedOperands.push_back(fusedOperand);
+    }
+
+    const Opcode last = expression.steps.back();
+    const bool isComparison = last >= OpcodeLessThan && last <= OpcodeNotEquals;
+    if(expression.reduction == OpcodeEmpty){
+        if(!isComparison){
+            Value output;
+            output.resize(size);
+            if(!evaluateFused(expression, fusedOperands, 0, size, output.mutableData()))
+                return false;
+            result = std::move(output);
+            return true;
+        }
+
+        Value output = Value::makeBytes(ValueTypeBoolean, size);
+        unsigned char* flags = output.mutableBytes();
+        double elements[FUSED_TILE];
+        for(size_t begin=0; begin<size; begin+=FUSED_TILE){
+            const size_t end = std::min(size, begin + FUSED_TILE);
+            if(!evaluateFused(expression, fusedOperands, begin, end, elements))
+                return false;
+            for(size_t i=begin; i<end; i++)
+                flags[i] = elements[i - begin] != 0.0;
+        }
+        result = std::move(output);
+        return true;
+    }
+
+    // # doesn't need the elements, only the errors of operators that report them
+    if(expression.reduction == OpcodeCount &&
+        std::none_of(expression.steps.begin(), expression.steps.end(), [](Opcode step){ return step == OpcodeDivide || step == OpcodeMod || step == OpcodePower; })){
+        result = {(double)size};
+        return true;
+    }
+
+    // the blocks and their partial results are reduced like the array of booleans or numbers would be,
+    // so the result is the same as without fusion
+    auto getBlock = [&expression, &fusedOperands](size_t begin, size_t end) -> const double*{
+        static thread_local std::vector<double> block(REDUCTION_BLOCK);
+        return evaluateFused(expression, fusedOperands, begin, end, block.data()) ? block.data() : nullptr;
+    };
+
+    double reduced = 0.0;
+    if(expression.reduction == OpcodeMultiplyAll){
+        if(!multiplyBlocks(size, getBlock, reduced))
+            return false;
+        result = {reduced};
+        return true;
+    }
+
+    const bool isCompensated = expression.reduction == OpcodeSumAll && isCompensatedSum && !isComparison;
+    if(size < PARALLEL_REDUCTION_SIZE){
+        // the sum carries over from block to block in order
+        double sum = 0.0;
+        double compensation = 0.0;
+        for(size_t begin=0; begin<size; begin+=REDUCTION_BLOCK){
+            const size_t end = std::min(size, begin + REDUCTION_BLOCK);
+            const double* numbers = getBlock(begin, end);
+            if(numbers == nullptr)
+                return false;
+            if(isCompensated)
+                reduced = ArrayKernels::compensatedSum(numbers, end - begin, sum, compensation);
+            else
+                reduced = sum = ArrayKernels::sum(numbers, end - begin, sum);
+        }
+    }else{
+        std::atomic<bool> failed(false);
+        std::vector<double> partials;
+        reduceBlocks(size, [&getBlock, &failed, isCompensated](size_t begin, size_t end){
+            const double* numbers = failed.load(std::memory_order_relaxed) ? nullptr : getBlock(begin, end);
+            if(numbers == nullptr){
+                failed.store(true, std::memory_order_relaxed);
+                return 0.0;
+            }
+            return isCompensated ? ArrayKernels::compensatedSumInLanes(numbers, end - begin) : ArrayKernels::sumInLanes(numbers, end - begin);
+        }, partials);
+        if(failed.load())
+            return false;
+
+        double sum = 0.0;
+        double compensation = 0.0;
+        reduced = isCompensated ? ArrayKernels::compensatedSum(partials.data(), partials.size(), sum, compensation) : ArrayKernels::sum(partials.data(), partials.size());
+    }
 
-    result->push_back(prod);
+    result = {expression.reduction == OpcodeCount ? (double)size : reduced};
+    return true;
+}
 
-    return std::move(result);
+bool InterpreterCalculator::evaluateFused(const FusedExpression& expression, const std::vector<FusedOperand>& operands, size_t begin, size_t end, double* elements)
+{
+    for(size_t i=begin; i<end; i+=FUSED_TILE){
+        if(!evaluateFusedTile(expression, operands, i, std::min(end - i, (size_t)FUSED_TILE), elements + (i - begin)))
+            return false;
+    }
+    return true;
 }
 
-std::unique_ptr<Value> InterpreterCalculator::findUnion(
+bool InterpreterCalculator::evaluateFusedTile(const FusedExpression& expression, const std::vector<FusedOperand>& operands, size_t begin, size_t size, double* elements)
+{
+    // every depth of the stack has its own tile, an operator writes over the tile of its left operand
+    static thread_local std::vector<double> tiles;
+    static thread_local std::vector<std::pair<const double*, size_t>> stack;
+    if(tiles.size() < operands.size() * FUSED_TILE)
+        tiles.resize(operands.size() * FUSED_TILE);
+    stack.clear();
+
+    size_t operand = 0;
+    for(const auto step: expression.steps){
+        if(step < OpcodeAdd){
+            const FusedOperand& fusedOperand = operands[operand++];
+            double* tile = tiles.data() + stack.size() * FUSED_TILE;
+            if(fusedOperand.size == 1){
+                tile[0] = fusedOperand.numbers != nullptr ? fusedOperand.numbers[0] : Value::byteToNumber(fusedOperand.type, fusedOperand.bytes[0]);
+                stack.push_back({tile, 1});
+            }else if(fusedOperand.numbers != nullptr){
+                stack.push_back({fusedOperand.numbers + begin, size});
+            }else{
+                for(size_t i=0; i<size; i++)
+                    tile[i] = Value::byteToNumber(fusedOperand.type, fusedOperand.bytes[begin + i]);
+                stack.push_back({tile, size});
+            }
+            continue;
+        }
+
+        const std::pair<const double*, size_t> right = stack.back();
+        stack.pop_back();
+        std::pair<const double*, size_t>& left = stack.back();
+        double* tile = tiles.data() + (stack.size() - 1) * FUSED_TILE;
+        const size_t resultSize = std::max(left.second, right.second);
+        if(!calculateFusedStep(step, left.first, left.second, right.first, right.second, tile, resultSize))
+            return false;
+        left = {tile, resultSize};
+    }
+
+    const std::pair<const double*, size_t>& value = stack.back();
+    if(value.second == size)
+        std::memcpy(elements, value.first, size * sizeof(double));
+    else
+        std::fill(elements, elements + size, value.first[0]);
+    return true;
+}
+
+bool InterpreterCalculator::calculateFusedStep(
+    Opcode opcode,
+    const double* left,
+    size_t leftSize,
+    const double* right,
+    size_t rightSize,
+    double* result,
+    size_t size)
+{
+    switch(opcode)
+    {
+    case OpcodeAdd:
+        ArrayKernels::calculate(ArrayOperationAdd, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeSubtract:
+        ArrayKernels::calculate(ArrayOperationSubtract, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeMultiply:
+        ArrayKernels::calculate(ArrayOperationMultiply, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeDivide:
+        if(ArrayKernels::hasZero(right, rightSize, false))
+            return false;
+        ArrayKernels::calculate(ArrayOperationDivide, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeMod:
+        if(ArrayKernels::hasZero(right, rightSize, true))
+            return false;
+        ArrayKernels::calculate(ArrayOperationMod, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodePower:
+        if(ArrayKernels::hasZero(left, leftSize, false) && ArrayKernels::hasZero(right, rightSize, false))
+            return false;
+        ArrayKernels::calculate(ArrayOperationPower, left, leftSize, right, rightSize, result, size);
+        return !ArrayKernels::hasNaN(result, size);
+    case OpcodeLessThan:
+        ArrayKernels::compare(ArrayComparisonLessThan, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeGreaterThan:
+        ArrayKernels::compare(ArrayComparisonGreaterThan, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeLessThanOrEquals:
+        ArrayKernels::compare(ArrayComparisonLessThanOrEquals, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeGreaterThanOrEquals:
+        ArrayKernels::compare(ArrayComparisonGreaterThanOrEquals, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeIsEquals:
+        ArrayKernels::compare(ArrayComparisonEquals, left, leftSize, right, rightSize, result, size);
+        return true;
+    case OpcodeNotEquals:
+        ArrayKernels::compare(ArrayComparisonNotEquals, left, leftSize, right, rightSize, result, size);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void InterpreterCalculator::reduceBlocks(size_t size, const std::function<double(size_t, size_t)>& reduction, std::vector<double>& partials)
+{
+    const size_t blockSize = REDUCTION_BLOCK;
+    const size_t blocks = (size + blockSize - 1) / blockSize;
+    partials.resize(blocks);
+
+    // every task reduces a run of consecutive blocks
+    auto reduceRun = [&reduction, &partials, size, blockSize, blocks](size_t task, size_t tasks){
+        for(size_t i=blocks * task / tasks; i<blocks * (task + 1) / tasks; i++){
+            const size_t begin = i * blockSize;
+            partials[i] = reduction(begin, std::min(size, begin + blockSize));
+        }
+    };
+
+    ThreadPool& pool = ThreadPool::getInstance();
+    const size_t tasks = size < PARALLEL_REDUCTION_SIZE ? 1 : std::min(blocks, (size_t)(reductionTasks > 0 ? reductionTasks : pool.getSize()));
+    if(tasks == 1){
+        reduceRun(0, 1);
+        return;
+    }
+
+    TaskGroup group;
+    for(size_t i=0; i<tasks; i++)
+        pool.submit(group, std::bind(reduceRun, i, tasks));
+    pool.wait(group);
+}
+
+bool InterpreterCalculator::multiplyBlocks(size_t size, const std::function<const double*(size_t, size_t)>& getBlock, double& product)
+{
+    product = 1.0;
+    if(size >= PARALLEL_REDUCTION_SIZE){
+        const size_t blocks = (size + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+        std::vector<double> smallest(blocks);
+        std::vector<double> largest(blocks);
+        std::atomic<bool> failed(false);
+        std::vector<double> partials;
+        reduceBlocks(size, [&getBlock, &smallest, &largest, &failed](size_t begin, size_t end){
+            const double* numbers = failed.load(std::memory_order_relaxed) ? nullptr : getBlock(begin, end);
+            if(numbers == nullptr){
+                failed.store(true, std::memory_order_relaxed);
+                return 0.0;
+            }
+            return ArrayKernels::product(numbers, end - begin, smallest[begin / REDUCTION_BLOCK], largest[begin / REDUCTION_BLOCK]);
+        }, partials);
+        if(failed.load())
+            return false;
+
+        // the running products of the sequential loop are the product of the blocks before times the running products of a block,
+        // both have to stay normal, the margin covers their rounding
+        size_t i = 0;
+        for(; i<blocks; i++){
+            const long double before = std::abs(product);
+            if(!std::isnormal(partials[i]) || smallest[i] < 2.0 * DBL_MIN || largest[i] > 0.5 * DBL_MAX ||
+                before * smallest[i] < 2.0L * DBL_MIN || before * largest[i] > 0.5L * DBL_MAX)
+                break;
+            product *= partials[i];
+        }
+        if(i == blocks)
+            return true;
+        product = 1.0;
+    }
+
+    for(size_t begin=0; begin<size; begin+=REDUCTION_BLOCK){
+        const size_t end = std::min(size, begin + REDUCTION_BLOCK);
+        const double* numbers = getBlock(begin, end);
+        if(numbers == nullptr)
+            return false;
+        product = ArrayKernels::product(numbers, end - begin, product);
+    }
+    return true;
+}
+
+void InterpreterCalculator::findUnion(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    if((!validateInput(left, reporter, hadError)) || (!validateInput(right, reporter, hadError)))
-        return std::move(std::make_unique<Value>());
+    if((!validateInput(left, reporter, hadError)) || (!validateInput(right, reporter, hadError))){
+        result.clear();
+        return;
+    }
 
-    auto result = std::make_unique<Value>(left);
-    result->reserve(left.size() + right.size());
-    for(const auto& i: right)
-        result->push_back(i);
+    if(left.type() != ValueTypeNumber && left.type() == right.type()){
+        const int leftSize = left.size();
+        const int rightSize = right.size();
+        Value output = Value::makeBytes(left.type(), leftSize + rightSize);
+        unsigned char* bytes = output.mutableBytes();
+        std::memcpy(bytes, left.bytes(), leftSize);
+        std::memcpy(bytes + leftSize, right.bytes(), rightSize);
+        result = std::move(output);
+        return;
+    }
 
-    return std::move(result);
+    // the right parameter is appended to the numbers of the left one if they aren't shared
+    const Value appended = right;
+    if(&result != &left)
+        result = left;
+    result.reserve(result.size() + appended.size());
+    for(const auto& i: appended)
+        result.push_back(i);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::select(
+void InterpreterCalculator::select(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
     const int leftSize = left.size();
     if(leftSize == 0 || right.size() == 0){
         hadError = true;
         if(reporter)
             reporter->report(RuntimeErrorTypeEmptyData);
-        return std::move(result);
+        result.clear();
+        return;
+    }
+
+    const int rightSize = right.size();
+    if(left.type() != ValueTypeNumber && rightSize > (int)Value::INLINE_CAPACITY){
+        // selected bytes are copied
+        Value output = Value::makeBytes(left.type(), rightSize);
+        unsigned char* bytes = output.mutableBytes();
+        const unsigned char* leftBytes = left.bytes();
+        int size = 0;
+        for(int i=0; i<rightSize; i++){
+            int index = floor(right[i])-1;
+            if(index>=0 && index<leftSize)
+                bytes[size++] = leftBytes[index];
+        }
+        if(size == 0)
+            output = {0.0};
+        else
+            output.resize(size);
+
+        result = std::move(output);
+        return;
     }
-    result->reserve(right.size());
 
-    for(const auto& i: right){
-        int index = floor(i)-1;
+    // numbers of ranges are calculated when they are selected
+    Value output;
+    output.reserve(rightSize);
+    for(int i=0; i<rightSize; i++){
+        int index = floor(right[i])-1;
         if(index>=0 && index<leftSize)
-            result->push_back(left[index]);
+            output.push_back(left[index]);
     }
-    if(result->size() == 0)
-        result->push_back(0.0);
+    if(output.size() == 0)
+        output.push_back(0.0);
 
-    return std::move(result);
+    result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::randomize(
+void InterpreterCalculator::randomize(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
-
-    result->reserve(left.size());
-    for(const auto& i: left)
-        result->push_back(i*RandomGenerator::generateRandom());
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    return std::move(result);
+    const int size = left.size();
+    Value output;
+    Value& destination = getDestination(left, left, result, size, output);
+    double* numbers = destination.mutableData();
+    const double* leftNumbers = left.data();
+    for(int i=0; i<size; i++)
+        numbers[i] = leftNumbers[i]*RandomGenerator::generateRandom();
+
+    if(&destination == &output)
+        result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::findCeil(
+void InterpreterCalculator::findCeil(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
-
-    result->reserve(left.size());
-    for(const auto& i: left)
-        result->push_back(ceil(i));
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    return std::move(result);
+    const int size = left.size();
+    Value output;
+    Value& destination = getDestination(left, left, result, size, output);
+    double* numbers = destination.mutableData();
+    const double* leftNumbers = left.data();
+    for(int i=0; i<size; i++)
+        numbers[i] = ceil(leftNumbers[i]);
+
+    if(&destination == &output)
+        result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::findFloor(
+void InterpreterCalculator::findFloor(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
-
-    result->reserve(left.size());
-    for(const auto& i: left)
-        result->push_back(floor(i));
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    return std::move(result);
+    const int size = left.size();
+    Value output;
+    Value& destination = getDestination(left, left, result, size, output);
+    double* numbers = destination.mutableData();
+    const double* leftNumbers = left.data();
+    for(int i=0; i<size; i++)
+        numbers[i] = floor(leftNumbers[i]);
+
+    if(&destination == &output)
+        result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::findRound(
+void InterpreterCalculator::findRound(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
-
-    result->reserve(left.size());
-    for(const auto& i: left)
-        result->push_back(round(i));
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    return std::move(result);
+    const int size = left.size();
+    Value output;
+    Value& destination = getDestination(left, left, result, size, output);
+    double* numbers = destination.mutableData();
+    const double* leftNumbers = left.data();
+    for(int i=0; i<size; i++)
+        numbers[i] = round(leftNumbers[i]);
+
+    if(&destination == &output)
+        result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::sortArray(
+void InterpreterCalculator::sortArray(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    *result = left;
-    std::sort(result->begin(), result->end());
+    if(left.isRange()){
+        // a range is sorted already or sorted by reversing it
+        result = left.rangeStep() >= 0.0 ? left : Value::makeRange(left.back(), -left.rangeStep(), left.size());
+        return;
+    }
 
-    return std::move(result);
+    // an expiring parameter is sorted in place
+    if(&result != &left)
+        result = left;
+    if(result.type() != ValueTypeNumber){
+        ArraySort::sortBytes(result.mutableBytes(), result.size(), result.type() == ValueTypeCharacter);
+        return;
+    }
+
+    ArraySort::sortNumbers(result.mutableData(), result.size());
 }
 
 
-std::unique_ptr<Value> InterpreterCalculator::reverseArray(
+void InterpreterCalculator::reverseArray(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
+
+    if(left.isRange()){
+        result = Value::makeRange(left.back(), -left.rangeStep(), left.size());
+        return;
+    }
 
-    *result = left;
-    std::reverse(result->begin(), result->end());
+    if(&result != &left)
+        result = left;
+    if(result.type() != ValueTypeNumber){
+        unsigned char* bytes = result.mutableBytes();
+        std::reverse(bytes, bytes + result.size());
+        return;
+    }
 
-    return std::move(result);
+    double* numbers = result.mutableData();
+    std::reverse(numbers, numbers + result.size());
 }
 
-std::unique_ptr<Value> InterpreterCalculator::makeSet(
+void InterpreterCalculator::makeSet(
     const Value& left,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    std::unordered_set<double> seen;
-    for(const auto& i: left){
-        if(seen.find(i) == seen.end()){
-            seen.insert(i);
-            result->push_back(i);
+    if(left.type() != ValueTypeNumber){
+        // the first of every byte value is kept
+        const int size = left.size();
+        const unsigned char* leftBytes = left.bytes();
+        Value output = Value::makeBytes(left.type(), size);
+        unsigned char* bytes = output.mutableBytes();
+        bool seen[BYTE_VALUES] = {};
+        int setSize = 0;
+        for(int i=0; i<size; i++){
+            if(!seen[leftBytes[i]]){
+                seen[leftBytes[i]] = true;
+                bytes[setSize++] = leftBytes[i];
+            }
         }
+        output.resize(setSize);
+
+        result = std::move(output);
+        return;
     }
 
-    return std::move(result);
+    const size_t size = left.size();
+    const double* numbers = left.data();
+    Value output;
+    size_t setSize = 0;
+    size_t domain;
+    if(getDenseDomain(numbers, size, size, domain)){
+        // every number is written and kept if it is the first, the set has at most domain numbers
+        output.resize(std::min(size, domain + 1));
+        double* setNumbers = output.mutableData();
+        std::vector<unsigned char> seen(domain);
+        for(size_t i=0; i<size; i++){
+            const size_t index = (size_t)numbers[i];
+            setNumbers[setSize] = numbers[i];
+            setSize += 1 - seen[index];
+            seen[index] = 1;
+        }
+    }else{
+        output.resize(size);
+        double* setNumbers = output.mutableData();
+        NumberTable& seen = NumberTable::acquire(size);
+        for(size_t i=0; i<size; i++){
+            if(seen.add(numbers[i]))
+                setNumbers[setSize++] = numbers[i];
+        }
+    }
+    output.resize(setSize);
+
+    result = std::move(output);
+}
+
+void InterpreterCalculator::findBytes(ValueType type, const Value& numbers, bool found[BYTE_VALUES])
+{
+    const double* data = numbers.data();
+    size_t domain;
+    if(getDenseDomain(data, numbers.size(), numbers.size() + BYTE_VALUES, domain)){
+        std::vector<unsigned char> flags(domain);
+        for(size_t i=0; i<numbers.size(); i++)
+            flags[(size_t)data[i]] = 1;
+        for(int i=0; i<BYTE_VALUES; i++)
+            found[i] = isInDenseDomain(flags.data(), domain, Value::byteToNumber(type, (unsigned char)i));
+        return;
+    }
+
+    NumberTable& contained = NumberTable::acquire(numbers.size());
+    for(size_t i=0; i<numbers.size(); i++)
+        contained.add(data[i]);
+
+    for(int i=0; i<BYTE_VALUES; i++)
+        found[i] = contained.contains(Value::byteToNumber(type, (unsigned char)i));
+}
+
+bool InterpreterCalculator::getDenseDomain(const double* numbers, size_t size, size_t elements, size_t& domain)
+{
+    size_t maxDomain = DENSE_ELEMENT_FACTOR * elements;
+    if(maxDomain < MIN_DENSE_DOMAIN)
+        maxDomain = MIN_DENSE_DOMAIN;
+    if(maxDomain > MAX_DENSE_DOMAIN)
+        maxDomain = MAX_DENSE_DOMAIN;
+    double maximum = 0.0;
+    for(size_t i=0; i<size; i++){
+        const double number = numbers[i];
+        if(!(number >= 0.0 && number < maxDomain && number == (double)(size_t)number))
+            return false;
+        maximum = std::max(maximum, number);
+    }
+
+    domain = (size_t)maximum + 1;
+    return true;
+}
+
+bool InterpreterCalculator::isInDenseDomain(const unsigned char* flags, size_t domain, double number)
+{
+    if(!(number >= 0.0 && number < domain))
+        return false;
+
+    const size_t index = (size_t)number;
+    return (double)index == number && (flags == nullptr || flags[index] != 0);
 }
 
 void InterpreterCalculator::rotateToLeft(const Value& src, Value& dest, long long positions)
@@ -562,116 +1433,238 @@ void InterpreterCalculator::rotateToLeft(const Value& src, Value& dest, long lon
 
 }
 
-std::unique_ptr<Value> InterpreterCalculator::leftRotate(
+void InterpreterCalculator::leftRotate(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    result->reserve(left.size());
-    rotateToLeft(left, *result, (long long)right[0]);
-    
-    return std::move(result);
+    Value output;
+    output.reserve(left.size());
+    rotateToLeft(left, output, (long long)right[0]);
+
+    result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::rightRotate(
+void InterpreterCalculator::rightRotate(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    result->reserve(left.size());
-    rotateToLeft(left, *result, -((long long)right[0]));
-    
-    return std::move(result);
+    Value output;
+    output.reserve(left.size());
+    rotateToLeft(left, output, -((long long)right[0]));
+
+    result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::remove(
+void InterpreterCalculator::remove(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    std::unordered_set<double> toRemove;
-    for(const auto& i: right)
-        toRemove.insert(i);
+    if(left.type() != ValueTypeNumber){
+        // every byte value is looked up once
+        bool found[BYTE_VALUES];
+        findBytes(left.type(), right, found);
+
+        const int size = left.size();
+        const unsigned char* leftBytes = left.bytes();
+        Value output = Value::makeBytes(left.type(), size);
+        unsigned char* bytes = output.mutableBytes();
+        int keptSize = 0;
+        for(int i=0; i<size; i++){
+            if(!found[leftBytes[i]])
+                bytes[keptSize++] = leftBytes[i];
+        }
+        if(keptSize == 0)
+            output = {0.0};
+        else
+            output.resize(keptSize);
 
-    for(const auto& i: left){
-        if(toRemove.find(i) == toRemove.end())
-            result->push_back(i);
+        result = std::move(output);
+        return;
     }
 
-    if(result->size() <= 0)
-        result->push_back(0.0);
+    const size_t size = left.size();
+    const double* leftNumbers = left.data();
+    const double* rightNumbers = right.data();
+    Value output;
+    output.resize(size);
+    double* keptNumbers = output.mutableData();
+    size_t keptSize = 0;
+    size_t domain;
+    if(getDenseDomain(rightNumbers, right.size(), size + right.size(), domain)){
+        std::vector<unsigned char> toRemove(domain);
+        for(size_t i=0; i<right.size(); i++)
+            toRemove[(size_t)rightNumbers[i]] = 1;
+        for(size_t i=0; i<size; i++){
+            keptNumbers[keptSize] = leftNumbers[i];
+            keptSize += !isInDenseDomain(toRemove.data(), domain, leftNumbers[i]);
+        }
+    }else{
+        NumberTable& toRemove = NumberTable::acquire(right.size());
+        for(size_t i=0; i<right.size(); i++)
+            toRemove.add(rightNumbers[i]);
+        for(size_t i=0; i<size; i++){
+            if(!toRemove.contains(leftNumbers[i]))
+                keptNumbers[keptSize++] = leftNumbers[i];
+        }
+    }
+    if(keptSize == 0)
+        output = {0.0};
+    else
+        output.resize(keptSize);
 
-    return std::move(result);
+    result = std::move(output);
 }
 
- std::unique_ptr<Value> InterpreterCalculator::remain(
+void InterpreterCalculator::remain(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    std::unordered_set<double> toRemain;
-    for(const auto& i: right)
-        toRemain.insert(i);
+    if(left.type() != ValueTypeNumber){
+        // every byte value is looked up once
+        bool found[BYTE_VALUES];
+        findBytes(left.type(), right, found);
+
+        const int size = left.size();
+        const unsigned char* leftBytes = left.bytes();
+        Value output = Value::makeBytes(left.type(), size);
+        unsigned char* bytes = output.mutableBytes();
+        int keptSize = 0;
+        for(int i=0; i<size; i++){
+            if(found[leftBytes[i]])
+                bytes[keptSize++] = leftBytes[i];
+        }
+        if(keptSize == 0)
+            output = {0.0};
+        else
+            output.resize(keptSize);
 
-    for(const auto& i: left){
-        if(toRemain.find(i) != toRemain.end())
-            result->push_back(i);
+        result = std::move(output);
+        return;
     }
 
-    if(result->size() <= 0)
-        result->push_back(0.0);
+    const size_t size = left.size();
+    const double* leftNumbers = left.data();
+    const double* rightNumbers = right.data();
+    Value output;
+    output.resize(size);
+    double* keptNumbers = output.mutableData();
+    size_t keptSize = 0;
+    size_t domain;
+    if(getDenseDomain(rightNumbers, right.size(), size + right.size(), domain)){
+        std::vector<unsigned char> toRemain(domain);
+        for(size_t i=0; i<right.size(); i++)
+            toRemain[(size_t)rightNumbers[i]] = 1;
+        for(size_t i=0; i<size; i++){
+            keptNumbers[keptSize] = leftNumbers[i];
+            keptSize += isInDenseDomain(toRemain.data(), domain, leftNumbers[i]);
+        }
+    }else{
+        NumberTable& toRemain = NumberTable::acquire(right.size());
+        for(size_t i=0; i<right.size(); i++)
+            toRemain.add(rightNumbers[i]);
+        for(size_t i=0; i<size; i++){
+            if(toRemain.contains(leftNumbers[i]))
+                keptNumbers[keptSize++] = leftNumbers[i];
+        }
+    }
+    if(keptSize == 0)
+        output = {0.0};
+    else
+        output.resize(keptSize);
 
-    return std::move(result);
+    result = std::move(output);
 }
 
-std::unique_ptr<Value> InterpreterCalculator::countEach(
+void InterpreterCalculator::countEach(
     const Value& left,
     const Value& right,
+    Value& result,
     bool& hadError,
     IRuntimeErrorReporter* reporter)
 {
-    auto result = std::make_unique<Value>();
-    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError))
-        return std::move(result);
+    if(!validateInput(left, reporter, hadError) || !validateInput(right, reporter, hadError)){
+        result.clear();
+        return;
+    }
 
-    std::unordered_map<double, int> numberCounts;
-    for(const auto& i: left){
-        auto count = numberCounts.find(i);
-        if(count == numberCounts.end()){
-            numberCounts[i] = 1;
-        }else{
-            count->second++;
-        }
+    const size_t size = right.size();
+    const double* leftNumbers = left.data();
+    const double* rightNumbers = right.data();
+    Value output;
+    output.resize(size);
+    double* counts = output.mutableData();
+    size_t domain;
+    if(getDenseDomain(leftNumbers, left.size(), left.size() + size, domain)){
+        std::vector<int> numberCounts(domain);
+        for(size_t i=0; i<left.size(); i++)
+            numberCounts[(size_t)leftNumbers[i]]++;
+        for(size_t i=0; i<size; i++)
+            counts[i] = isInDenseDomain(nullptr, domain, rightNumbers[i]) ? numberCounts[(size_t)rightNumbers[i]] : 0;
+    }else{
+        NumberTable& numberCounts = NumberTable::acquire(left.size());
+        for(size_t i=0; i<left.size(); i++)
+            numberCounts.add(leftNumbers[i]);
+        for(size_t i=0; i<size; i++)
+            counts[i] = numberCounts.count(rightNumbers[i]);
     }
 
-    for(const auto& i: right){
-        auto count = numberCounts.find(i);
-        if(count == numberCounts.end()){
-            result->push_back(0.0);
-        }else{
-            result->push_back((double)count->second);
-        }
+    result = std::move(output);
+}
+
+void InterpreterCalculator::shiftLeft(const Value& left, Value& result)
+{
+    const int size = left.size();
+    if(size > (int)Value::INLINE_CAPACITY && left.type() != ValueTypeNumber){
+        // a zero byte is 0 for characters and booleans
+        Value output = Value::makeBytes(left.type(), size);
+        unsigned char* bytes = output.mutableBytes();
+        std::memcpy(bytes, left.bytes() + 1, size - 1);
+        bytes[size - 1] = 0;
+        result = std::move(output);
+        return;
     }
 
-    return std::move(result);
+    Value output;
+    output.resize(size);
+    double* numbers = output.mutableData();
+    if(left.isRange()){
+        for(int i=0; i+1<size; i++)
+            numbers[i] = left[i + 1];
+    }else if(size > 1){
+        std::memcpy(numbers, left.data() + 1, (size - 1) * sizeof(double));
+    }
+    numbers[size - 1] = 0.0;
+    result = std::move(output);
 }
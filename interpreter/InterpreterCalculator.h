@@ -3,206 +3,366 @@
 #include <vector>
 #include <functional>
 #include "Interpreter.h"
+#include "ArrayKernels.h"
 
+// the result may be one of the parameters, an expiring parameter of the right size is reused for the result
+// characters and booleans are promoted to numbers by arithmetic, comparisons and logical not give booleans,
+// selecting, joining, sorting and filtering characters or booleans keeps their byte storage
 class InterpreterCalculator{
 public:
-    static std::unique_ptr<Value> add(
+    // the built-in operator on its parameters, a monadic operator ignores right, false if it isn't a built-in operator
+    static bool calculate(
+        TokenId operation,
         const Value& left,
         const Value& right,
+        Value& result,
+        bool& hadError,
+        IRuntimeErrorReporter* reporter);
+
+    static void add(
+        const Value& left,
+        const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
     
-    static std::unique_ptr<Value> subtract(
+    static void subtract(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> multiply(
+    static void multiply(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> divide(
+    static void divide(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> mod(
+    static void mod(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> iterate(
+    static void iterate(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> logicalNot(
+    static void logicalNot(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> count(
+    static void count(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> sumAll(
+    static void sumAll(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> multiplyAll(
+    static void multiplyAll(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> power(
+    static void power(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> lessThan(
+    static void lessThan(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> greaterThan(
+    static void greaterThan(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> lessThanOrEquals(
+    static void lessThanOrEquals(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
 
-    static std::unique_ptr<Value> greaterThanOrEquals(
+    static void greaterThanOrEquals(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> equals(
+    static void equals(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> notEquals(
+    static void notEquals(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> findUnion(
+    static void findUnion(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> select(
+    static void select(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> makeSet(
+    static void makeSet(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> randomize(
+    static void randomize(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> sine(
+    static void sine(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> convert(
+    static void convert(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> findCeil(
+    static void findCeil(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> findFloor(
+    static void findFloor(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> findRound(
+    static void findRound(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> sortArray(
+    static void sortArray(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> reverseArray(
+    static void reverseArray(
         const Value& left,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> leftRotate(
+    static void leftRotate(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> rightRotate(
+    static void rightRotate(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> remove(
+    static void remove(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> remain(
+    static void remain(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
-    static std::unique_ptr<Value> countEach(
+    static void countEach(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter);
 
+    // #+ adds the rounding errors of large sums back, which is slower
+    static void setCompensatedSum(bool isCompensated);
+
+    // maximum number of tasks a large reduction is split into, 0 uses the size of the thread pool
+    static void setReductionTasks(int tasks);
+
+    // every element is replaced by the next one and the last by 0, the neighbours apply to each pairs the elements with
+    static void shiftLeft(const Value& left, Value& result);
+
+    // fused expressions calculate arrays of at least this many elements
+    static const size_t FUSED_SIZE = 1024;
+
+    // the value of a fused expression, operands are the values of its steps that push one, in order,
+    // false if an operand isn't a single element or an array of the size of the result, or if an operator would
+    // report an error, the operators then calculate the value and report it
+    static bool calculateFused(const FusedExpression& expression, const std::vector<const Value*>& operands, Value& result);
+
 private:
+    // number of values of a character or boolean byte
+    static const int BYTE_VALUES = 256;
+
     using DyadicFunctionLambda = std::function<double(double, double, bool&, IRuntimeErrorReporter*)>;
 
-    static std::unique_ptr<Value> dyadicFunction(
+    static void dyadicFunction(
         const Value& left,
         const Value& right,
+        Value& result,
         bool& hadError,
         IRuntimeErrorReporter* reporter,
         DyadicFunctionLambda lambda
     );
 
+    // large results are booleans, characters compared to a single number are looked up by byte,
+    // numbers are compared by the kernel
+    template<typename Comparison>
+    static void compare(
+        const Value& left,
+        const Value& right,
+        Value& result,
+        bool& hadError,
+        IRuntimeErrorReporter* reporter,
+        ArrayComparison kernel,
+        Comparison comparison
+    );
+
+    // both parameters are non empty and store their numbers as doubles, so the kernels can read them directly
+    static bool areStoredNumbers(const Value& left, const Value& right);
+
+    // the result of a kernel, the result may be one of the parameters like in dyadicFunction
+    static void calculateNumbers(const Value& left, const Value& right, Value& result, ArrayOperation operation);
+
+    // the result may be one of the parameters, it is the destination if it has the size of the result,
+    // otherwise output is resized and returned
+    static Value& getDestination(const Value& left, const Value& right, Value& result, size_t size, Value& output);
+
+    // finds the range and the scalar of a range and scalar parameter pair
+    static bool getRangeAndScalar(const Value& left, const Value& right, const Value*& range, double& scalar, bool& isRangeLeft);
+
+    static bool isExactInteger(double number);
+
+    // result is the range offset + factor * range, false if the numbers wouldn't be exact integers
+    static bool transformRange(const Value& range, double offset, double factor, Value& result);
+
     static bool validateInput(const Value& input, IRuntimeErrorReporter* reporter, bool& hadError);
 
+    // marks the bytes of the element type whose numbers are in numbers
+    static void findBytes(ValueType type, const Value& numbers, bool found[BYTE_VALUES]);
+
+    // integers from 0 up to this many are looked up in flags or counts instead of a NumberTable
+    static const size_t MAX_DENSE_DOMAIN = 1 << 16;
+    // smaller domains are always dense, larger ones only if they have at most this many slots per element
+    static const size_t MIN_DENSE_DOMAIN = 256;
+    static const size_t DENSE_ELEMENT_FACTOR = 4;
+
+    // true if every number is a non-negative integer below a domain that is cheap enough for elements lookups,
+    // domain is set to the largest number + 1
+    static bool getDenseDomain(const double* numbers, size_t size, size_t elements, size_t& domain);
+
+    // the number is an integer below domain whose flag is set, every flag is set if flags is null
+    static bool isInDenseDomain(const unsigned char* flags, size_t domain, double number);
+
     static void rotateToLeft(const Value& src, Value& dest, long long positions);
+
+    // partial results of blocks of this many elements are combined in order, so a reduction doesn't depend on the number of tasks
+    static const size_t REDUCTION_BLOCK = 65536;
+    // arrays of at least this many elements are reduced on the thread pool
+    static const size_t PARALLEL_REDUCTION_SIZE = 4 * REDUCTION_BLOCK;
+
+    // partials[i] is the reduction of the elements of block i
+    static void reduceBlocks(size_t size, const std::function<double(size_t, size_t)>& reduction, std::vector<double>& partials);
+
+    // the product of the numbers that getBlock returns for every block, or false if it returns null for one,
+    // large arrays are multiplied in blocks on the thread pool and the block products are combined in order
+    // if no running product leaves the normal numbers, otherwise they're multiplied again left to right,
+    // so a 0, inf or NaN gives the same result as the sequential loop
+    static bool multiplyBlocks(size_t size, const std::function<const double*(size_t, size_t)>& getBlock, double& product);
+
+    static bool isCompensatedSum;
+    static int reductionTasks;
+
+    // integers up to this size are exact in a double
+    static constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;
+
+    // elements calculated at a time by a fused expression, so the tiles of its operands stay in the cache
+    static const size_t FUSED_TILE = 512;
+
+    // bytes are promoted to numbers one tile at a time
+    struct FusedOperand{
+        const double* numbers;
+        const unsigned char* bytes;
+        ValueType type;
+        size_t size;
+    };
+
+    // calculates the elements from begin to end tile by tile, false if an operator would report an error
+    static bool evaluateFused(const FusedExpression& expression, const std::vector<FusedOperand>& operands, size_t begin, size_t end, double* elements);
+
+    static bool evaluateFusedTile(const FusedExpression& expression, const std::vector<FusedOperand>& operands, size_t begin, size_t size, double* elements);
+
+    // an operator of a fused expression on tiles or single elements, false if it would report an error
+    static bool calculateFusedStep(
+        Opcode opcode,
+        const double* left,
+        size_t leftSize,
+        const double* right,
+        size_t rightSize,
+        double* result,
+        size_t size);
 };
\ No newline at end of file
@@ -0,0 +1,7 @@
+#pragma once
+
+enum InterpreterEngine{
+    InterpreterEngineTokens,        // interprets the token arrays directly
+    InterpreterEngineSyntaxTree,    // evaluates compiled syntax trees
+    InterpreterEngineBytecode       // runs bytecode lowered from the syntax trees
+};
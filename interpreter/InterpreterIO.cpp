@@ -43,8 +43,7 @@ void InterpreterIO::write(const Value& value)
 
 std::unique_ptr<Value> InterpreterIO::readText()
 {
-    std::string input;
-    auto result = std::make_unique<Value>();
+    std::string input, characters;
     std::cout << "text>";
     getline(std::cin, input);
     
@@ -52,23 +51,36 @@ std::unique_ptr<Value> InterpreterIO::readText()
         if(i < CHARS_START || i > CHARS_END)
             continue;
 
-        result->push_back((double)i);
+        characters.push_back(i);
     }
 
-    
-    if(result->size() == 0)
-        result->push_back(0.0);
+    if(characters.size() == 0)
+        return std::make_unique<Value>(Value{0.0});
 
-    return std::move(result);
+    return std::make_unique<Value>(Value::makeCharacters(characters.data(), characters.size()));
 }
     
 void InterpreterIO::writeText(const Value& value)
 {
-    for(const auto& i: value){
-        if(i<CHARS_START || i>CHARS_END)
-            continue;
-        
-        std::cout << ((char)i);
+    std::string text;
+    const int size = value.size();
+    if(value.type() == ValueTypeCharacter){
+        // characters are written from their bytes
+        const char* characters = reinterpret_cast<const char*>(value.bytes());
+        for(int i=0; i<size; i++){
+            if(characters[i]<CHARS_START || characters[i]>CHARS_END)
+                continue;
+
+            text.push_back(characters[i]);
+        }
+    }else{
+        for(int i=0; i<size; i++){
+            const double number = value[i];
+            if(number<CHARS_START || number>CHARS_END)
+                continue;
+
+            text.push_back((char)number);
+        }
     }
-    std::cout << std::endl;
+    std::cout << text << std::endl;
 }
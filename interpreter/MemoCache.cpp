@@ -0,0 +1,90 @@
+#include "MemoCache.h"
+#include <cstring>
+
+const size_t MemoCache::MAX_ENTRIES;
+const size_t MemoCache::MAX_PARAMETER_SIZE;
+const uint64_t MemoCache::HASH_FACTOR;
+
+bool MemoCache::isCacheable(const Value& left, const Value& right) const
+{
+    return (!hasLeft || left.size() <= MAX_PARAMETER_SIZE) && (!hasRight || right.size() <= MAX_PARAMETER_SIZE);
+}
+
+bool MemoCache::find(const Value& left, const Value& right, Value& result)
+{
+    const uint64_t hash = getHash(left, right);
+    std::lock_guard<std::mutex> guard(lock);
+    const auto found = positions.find(hash);
+    if(found == positions.end() || (hasLeft && !isSame(found->second->left, left)) ||
+        (hasRight && !isSame(found->second->right, right))){
+        statistics.misses++;
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, found->second);
+    result = found->second->result;
+    statistics.hits++;
+    return true;
+}
+
+void MemoCache::add(const Value& left, const Value& right, const Value& result)
+{
+    const uint64_t hash = getHash(left, right);
+    std::lock_guard<std::mutex> guard(lock);
+    const auto found = positions.find(hash);
+    if(found != positions.end()){
+        entries.erase(found->second);
+        positions.erase(found);
+    }else if(entries.size() == MAX_ENTRIES){
+        positions.erase(entries.back().hash);
+        entries.pop_back();
+    }
+
+    entries.push_front({hash, hasLeft ? left : Value(), hasRight ? right : Value(), result});
+    positions[hash] = entries.begin();
+}
+
+MemoStatistics MemoCache::getStatistics()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return statistics;
+}
+
+uint64_t MemoCache::getHash(const Value& left, const Value& right) const
+{
+    uint64_t hash = 0;
+    if(hasLeft)
+        hash = addToHash(hash, left);
+    // the sizes keep the elements of a from being taken for elements of b
+    hash = (hash ^ (hasLeft ? left.size() : 0)) * HASH_FACTOR;
+    if(hasRight)
+        hash = addToHash(hash, right);
+    return hash;
+}
+
+uint64_t MemoCache::addToHash(uint64_t hash, const Value& value)
+{
+    hash = (hash ^ value.type()) * HASH_FACTOR;
+    for(size_t i=0; i<value.size(); i++){
+        const double number = value[i];
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        hash = (hash ^ bits) * HASH_FACTOR;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+bool MemoCache::isSame(const Value& first, const Value& second)
+{
+    if(first.type() != second.type() || first.size() != second.size())
+        return false;
+
+    for(size_t i=0; i<first.size(); i++){
+        const double firstNumber = first[i];
+        const double secondNumber = second[i];
+        if(std::memcmp(&firstNumber, &secondNumber, sizeof(double)) != 0)
+            return false;
+    }
+    return true;
+}
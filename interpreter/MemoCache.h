@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "../token/Value.h"
+
+struct MemoStatistics{
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+// results of a function that only depends on its parameters, keyed on the parameters its body reads,
+// the least recently used result is dropped when MAX_ENTRIES are cached, calls may come from several threads
+class MemoCache{
+public:
+    MemoCache(bool hasLeft, bool hasRight): hasLeft(hasLeft), hasRight(hasRight){}
+
+    // the cached result for the parameters, or the result of function, which is cached if it succeeds,
+    // failed calls aren't cached so their errors are reported again
+    template<typename Call>
+    bool call(const Value& left, const Value& right, Value& result, Call function)
+    {
+        if(!isCacheable(left, right))
+            return function();
+        if(find(left, right, result))
+            return true;
+        if(!function())
+            return false;
+
+        add(left, right, result);
+        return true;
+    }
+
+    MemoStatistics getStatistics();
+
+private:
+    static const size_t MAX_ENTRIES = 1024;
+    static const size_t MAX_PARAMETER_SIZE = 64;
+    static const uint64_t HASH_FACTOR = 0x9E3779B97F4A7C15ULL;
+
+    struct Entry{
+        uint64_t hash;
+        Value left;
+        Value right;
+        Value result;
+    };
+
+    // parameters the body doesn't read are cached as empty values
+    const bool hasLeft;
+    const bool hasRight;
+    // most recently used first
+    std::list<Entry> entries;
+    // parameters with the same hash replace each other
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> positions;
+    MemoStatistics statistics;
+    std::mutex lock;
+
+    // parameters larger than MAX_PARAMETER_SIZE are neither looked up nor added
+    bool isCacheable(const Value& left, const Value& right) const;
+
+    // false if the parameters aren't cached, a found result becomes the most recently used one
+    bool find(const Value& left, const Value& right, Value& result);
+
+    void add(const Value& left, const Value& right, const Value& result);
+
+    uint64_t getHash(const Value& left, const Value& right) const;
+
+    static uint64_t addToHash(uint64_t hash, const Value& value);
+
+    // same type and the same bits in every element, so 0 and -0 are different parameters
+    static bool isSame(const Value& first, const Value& second);
+};
@@ -0,0 +1,153 @@
+#include "NumberTable.h"
+#include <algorithm>
+#include <cstring>
+
+const uint64_t NumberTable::EMPTY_KEY;
+
+NumberTable& NumberTable::acquire(size_t expected)
+{
+    static thread_local NumberTable table;
+    table.reset(expected);
+    return table;
+}
+
+bool NumberTable::add(double number)
+{
+    const uint64_t key = getKey(number);
+    if(isSmall){
+        uint64_t* end = keys.data() + distinct;
+        uint64_t* position = std::lower_bound(keys.data(), end, key);
+        const size_t index = position - keys.data();
+        if(position != end && *position == key){
+            counts[index]++;
+            return false;
+        }
+        if(distinct < SMALL_SIZE){
+            std::copy_backward(position, end, end + 1);
+            std::copy_backward(counts.data() + index, counts.data() + distinct, counts.data() + distinct + 1);
+            *position = key;
+            counts[index] = 1;
+            distinct++;
+            return true;
+        }
+        leaveSmall();
+    }
+
+    size_t slot = findSlot(key);
+    if(keys[slot] == key){
+        counts[slot]++;
+        return false;
+    }
+
+    // at most half of the slots are used
+    if(2 * (distinct + 1) > keys.size()){
+        rehash(2 * keys.size());
+        slot = findSlot(key);
+    }
+    keys[slot] = key;
+    counts[slot] = 1;
+    distinct++;
+    return true;
+}
+
+int NumberTable::count(double number) const
+{
+    const uint64_t key = getKey(number);
+    if(isSmall){
+        const uint64_t* end = keys.data() + distinct;
+        const uint64_t* position = std::lower_bound(keys.data(), end, key);
+        return position != end && *position == key ? counts[position - keys.data()] : 0;
+    }
+
+    const size_t slot = findSlot(key);
+    return keys[slot] == key ? counts[slot] : 0;
+}
+
+uint64_t NumberTable::getKey(double number)
+{
+    if(number != number)
+        return 0x7FF8000000000000ULL;
+    if(number == 0.0)
+        return 0;
+
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+    return bits;
+}
+
+void NumberTable::reset(size_t expected)
+{
+    distinct = 0;
+    isSmall = expected <= SMALL_SIZE;
+    if(isSmall){
+        if(keys.size() < SMALL_SIZE){
+            keys.resize(SMALL_SIZE);
+            counts.resize(SMALL_SIZE);
+        }
+        return;
+    }
+
+    size_t capacity = 4 * SMALL_SIZE;
+    while(capacity < 2 * (expected < MAX_EXPECTED ? expected : MAX_EXPECTED))
+        capacity *= 2;
+    // the storage of a very large table isn't kept for small ones
+    if(keys.capacity() > MAX_KEPT_CAPACITY && keys.capacity() > 4 * capacity){
+        std::vector<uint64_t>().swap(keys);
+        std::vector<int>().swap(counts);
+    }
+    rehash(capacity);
+}
+
+size_t NumberTable::findSlot(uint64_t key) const
+{
+    const size_t mask = keys.size() - 1;
+    size_t slot = (key * HASH_FACTOR) >> shift;
+    while(keys[slot] != key && keys[slot] != EMPTY_KEY)
+        slot = (slot + 1) & mask;
+
+    return slot;
+}
+
+void NumberTable::rehash(size_t capacity)
+{
+    std::vector<uint64_t> oldKeys;
+    std::vector<int> oldCounts;
+    if(distinct > 0){
+        oldKeys.swap(keys);
+        oldCounts.swap(counts);
+    }
+
+    // only the used slots of kept storage are written
+    keys.assign(capacity, EMPTY_KEY);
+    counts.resize(capacity);
+    shift = 64;
+    for(size_t i=capacity; i>1; i/=2)
+        shift--;
+
+    for(size_t i=0; i<oldKeys.size(); i++){
+        if(oldKeys[i] == EMPTY_KEY)
+            continue;
+        const size_t slot = findSlot(oldKeys[i]);
+        keys[slot] = oldKeys[i];
+        counts[slot] = oldCounts[i];
+    }
+}
+
+void NumberTable::leaveSmall()
+{
+    uint64_t smallKeys[SMALL_SIZE];
+    int smallCounts[SMALL_SIZE];
+    const size_t smallSize = distinct;
+    std::copy(keys.begin(), keys.begin() + smallSize, smallKeys);
+    std::copy(counts.begin(), counts.begin() + smallSize, smallCounts);
+
+    isSmall = false;
+    distinct = 0;
+    rehash(8 * SMALL_SIZE);
+    for(size_t i=0; i<smallSize; i++){
+        const size_t slot = findSlot(smallKeys[i]);
+        keys[slot] = smallKeys[i];
+        counts[slot] = smallCounts[i];
+    }
+    distinct = smallSize;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// counts of distinct numbers for the set operators, -0 is the same number as 0 and every NaN is the same number,
+// up to SMALL_SIZE numbers are kept sorted and binary searched, more are hashed into open addressed slots
+class NumberTable{
+public:
+    // the table of the calling thread, emptied and sized for about expected distinct numbers,
+    // its storage is kept between calls
+    static NumberTable& acquire(size_t expected);
+
+    // adds 1 to the count of the number, true if the number wasn't in the table
+    bool add(double number);
+
+    // 0 if the number isn't in the table
+    int count(double number) const;
+
+    bool contains(double number) const { return count(number) != 0; }
+
+    size_t size() const { return distinct; }
+
+private:
+    static const size_t SMALL_SIZE = 16;
+    // a larger expected size only sizes the table for this many numbers, it grows past them when they are added
+    static const size_t MAX_EXPECTED = 1 << 16;
+    static const size_t MAX_KEPT_CAPACITY = 1 << 20;
+    static const uint64_t EMPTY_KEY = ~0ULL;
+    static const uint64_t HASH_FACTOR = 0x9E3779B97F4A7C15ULL;
+
+    std::vector<uint64_t> keys;
+    std::vector<int> counts;
+    size_t distinct = 0;
+    bool isSmall = true;
+    // the slot of a key is the top bits of its hash
+    int shift = 64;
+
+    // the bits of the number, never EMPTY_KEY
+    static uint64_t getKey(double number);
+
+    void reset(size_t expected);
+
+    // the slot of the key or the empty slot it would be added to
+    size_t findSlot(uint64_t key) const;
+
+    // rehashes into capacity slots, capacity is a power of 2
+    void rehash(size_t capacity);
+
+    // moves the sorted numbers into slots
+    void leaveSmall();
+};
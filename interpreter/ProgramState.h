@@ -1,22 +1,42 @@
 #pragma once
+#include <atomic>
+#include <deque>
 #include <unordered_map>
 #include <vector>
 #include <mutex>
 #include <thread>
 #include "../scanner/Function.h"
 #include "../token/Token.h"
+#include "../compiler/SyntaxTree.h"
+#include "../compiler/Bytecode.h"
+#include "MemoCache.h"
+#include "ShardedLock.h"
+#include "ThreadPool.h"
 
 
 struct Variable{
     Value value;
-    std::mutex mut;
+    // a variable that was never assigned reads as 0
+    bool isDefined = false;
 };
 
 // global program state
 struct ProgramState{
+    static const int VARIABLE_LOCKS = 8;
+
     std::unordered_map<std::string, Function> functions;
-    std::unordered_map<std::string, Variable> variables;
-    std::vector<std::thread> threads;
+    std::unordered_map<std::string, SyntaxBlock> compiledFunctions;
+    std::unordered_map<std::string, BytecodeBlock> bytecodeFunctions;
+    // indexed by the slots of the variable tokens, the slots are allocated before the program runs
+    std::deque<Variable> variables;
+    // variables are only locked while async blocks may be running
+    std::atomic<bool> isConcurrent{false};
+    // a variable is guarded by the lock of its slot modulo the number of locks
+    ShardedLock variableLocks[VARIABLE_LOCKS];
+    // async blocks that run on the thread pool
+    TaskGroup tasks;
+    // caches of the functions that are memoized while the program runs, by name
+    std::unordered_map<std::string, MemoCache> memoCaches;
     std::mutex IOReadLock;
     std::mutex IOWriteLock;
 };
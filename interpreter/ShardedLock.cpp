@@ -0,0 +1,45 @@
+#include "ShardedLock.h"
+#include <thread>
+
+void ShardedLock::lockShared()
+{
+    Shard& shard = shards[getShard()];
+    while(true){
+        // the reader is counted before it checks for a writer, the writer sets its flag before it counts readers
+        shard.readers.fetch_add(1, std::memory_order_seq_cst);
+        if(!isWriting.load(std::memory_order_seq_cst))
+            return;
+
+        shard.readers.fetch_sub(1, std::memory_order_release);
+        while(isWriting.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+}
+
+void ShardedLock::unlockShared()
+{
+    shards[getShard()].readers.fetch_sub(1, std::memory_order_release);
+}
+
+void ShardedLock::lock()
+{
+    writers.lock();
+    isWriting.store(true, std::memory_order_seq_cst);
+    for(auto& i: shards){
+        while(i.readers.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+    }
+}
+
+void ShardedLock::unlock()
+{
+    isWriting.store(false, std::memory_order_release);
+    writers.unlock();
+}
+
+int ShardedLock::getShard()
+{
+    static std::atomic<int> nextShard{0};
+    static thread_local const int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return shard;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+
+// reader-writer lock where readers only write the counter of their own shard,
+// so reading threads don't contend for a cache line, a writer waits for the readers of every shard
+class ShardedLock{
+public:
+    void lockShared();
+
+    void unlockShared();
+
+    void lock();
+
+    void unlock();
+
+private:
+    static const int SHARDS = 16;
+    static const int CACHE_LINE = 64;
+
+    struct alignas(CACHE_LINE) Shard{
+        std::atomic<int> readers{0};
+    };
+
+    // threads are given shards in turn
+    static int getShard();
+
+    Shard shards[SHARDS];
+    alignas(CACHE_LINE) std::atomic<bool> isWriting{false};
+    std::mutex writers;
+};
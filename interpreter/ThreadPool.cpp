@@ -0,0 +1,153 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+int ThreadPool::configuredSize = 0;
+thread_local int ThreadPool::workerIndex = -1;
+thread_local std::vector<const TaskGroup*> ThreadPool::runningGroups;
+
+void ThreadPool::setSize(int size)
+{
+    configuredSize = size;
+}
+
+ThreadPool& ThreadPool::getInstance()
+{
+    static ThreadPool pool(configuredSize > 0 ? configuredSize : getDefaultSize());
+    return pool;
+}
+
+int ThreadPool::getDefaultSize()
+{
+    const char* threads = std::getenv("INTERPRETER_THREADS");
+    if(threads != nullptr && std::atoi(threads) > 0)
+        return std::atoi(threads);
+
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool::ThreadPool(int size)
+{
+    for(int i=0; i<size; i++)
+        workers.push_back(std::make_unique<Worker>());
+    for(int i=0; i<size; i++)
+        workers[i]->thread = std::thread(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isStopping = true;
+    }
+    wakeUp.notify_all();
+    for(auto& i: workers)
+        i->thread.join();
+}
+
+void ThreadPool::submit(TaskGroup& group, Task task)
+{
+    group.pending.fetch_add(1, std::memory_order_acq_rel);
+
+    // a worker keeps the tasks it spawns, other threads spread them over the workers
+    const int index = workerIndex >= 0 ? workerIndex : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->jobs.push_back({std::move(task), &group});
+    }
+
+    // a worker that found no jobs is either waiting or sees the new count
+    queuedJobs.fetch_add(1, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeUp.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group)
+{
+    // the count is checked under the lock, so the group isn't destroyed while a finished job notifies it
+    const bool isOwnGroup = std::find(runningGroups.begin(), runningGroups.end(), &group) != runningGroups.end();
+    std::unique_lock<std::mutex> lock(group.mutex);
+    if(isOwnGroup){
+        group.waiting++;
+        group.finished.notify_all();
+    }
+
+    auto isFinished = [&group](){ return group.pending.load(std::memory_order_acquire) <= group.waiting; };
+    while(!isFinished()){
+        lock.unlock();
+        Job job;
+        const bool hasJob = takeJob(workerIndex, job);
+        if(hasJob)
+            runJob(job);
+        lock.lock();
+
+        // wakes up now and then to help with jobs queued in the meantime
+        if(!hasJob)
+            group.finished.wait_for(lock, std::chrono::milliseconds(1), isFinished);
+    }
+
+    if(isOwnGroup)
+        group.waiting--;
+}
+
+void ThreadPool::work(int index)
+{
+    workerIndex = index;
+    while(true){
+        Job job;
+        if(takeJob(index, job)){
+            runJob(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this](){ return isStopping || queuedJobs.load(std::memory_order_acquire) > 0; });
+        if(isStopping && queuedJobs.load(std::memory_order_acquire) == 0)
+            return;
+    }
+}
+
+bool ThreadPool::takeJob(int index, Job& job)
+{
+    if(index >= 0){
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if(!worker.jobs.empty()){
+            job = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+            queuedJobs.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+    }
+
+    const int size = workers.size();
+    for(int i=1; i<=size; i++){
+        Worker& victim = *workers[(index + i) % size];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.jobs.empty()){
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            queuedJobs.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::runJob(Job& job)
+{
+    runningGroups.push_back(job.group);
+    job.task();
+    job.task = nullptr;
+    runningGroups.pop_back();
+
+    // the waiter may destroy the group as soon as it sees the count, so it's notified under the lock
+    TaskGroup& group = *job.group;
+    std::lock_guard<std::mutex> lock(group.mutex);
+    group.pending.fetch_sub(1, std::memory_order_acq_rel);
+    group.finished.notify_all();
+}
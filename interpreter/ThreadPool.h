@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// tasks that are waited for together
+struct TaskGroup{
+    std::atomic<int> pending{0};
+    // pending tasks that wait for the group themselves, guarded by the mutex
+    int waiting = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+// process wide workers that run async blocks, every worker has its own deque of tasks,
+// it runs its newest task first and steals the oldest task of another worker when its deque is empty
+class ThreadPool{
+public:
+    typedef std::function<void()> Task;
+
+    // the size is read when the pool is first used, 0 uses INTERPRETER_THREADS or the hardware threads
+    static void setSize(int size);
+
+    static ThreadPool& getInstance();
+
+    ~ThreadPool();
+
+    void submit(TaskGroup& group, Task task);
+
+    // runs queued tasks while it waits, a task waiting for its own group only waits for the tasks that don't wait
+    void wait(TaskGroup& group);
+
+    int getSize() const { return workers.size(); }
+
+private:
+    struct Job{
+        Task task;
+        TaskGroup* group;
+    };
+
+    struct Worker{
+        std::deque<Job> jobs;
+        std::mutex mutex;
+        std::thread thread;
+    };
+
+    explicit ThreadPool(int size);
+
+    static int getDefaultSize();
+
+    void work(int index);
+
+    // the newest job of the worker or the oldest job of another worker
+    bool takeJob(int index, Job& job);
+
+    void runJob(Job& job);
+
+    static int configuredSize;
+    // worker of the current thread, -1 outside the pool
+    static thread_local int workerIndex;
+    // groups of the jobs the current thread is running
+    static thread_local std::vector<const TaskGroup*> runningGroups;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> queuedJobs{0};
+    std::atomic<unsigned> nextWorker{0};
+    bool isStopping = false;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+};
@@ -7,16 +7,17 @@
 #include <iostream>
 #include <cctype>
 
-void REPL::run()
+void REPL::run(InterpreterEngine engine)
 {
     ErrorPrinter errorPrinter;
     REPLPreprocessorErrorPrinter preprocessorErrorPrinter;
     InterpreterIO io;
-    Interpreter interpreter(&errorPrinter, &io);
+    Interpreter interpreter(&errorPrinter, &io, engine);
     std::vector<Token> tokens;
     std::vector<const Token*> tokensRef;
     std::unordered_map<std::string, Function> functions = {};
     std::unordered_set<std::string> functionNames;
+    std::unordered_map<std::string, int> variableSlots;
     ProgramState programState;
 
     std::string source;
@@ -38,7 +39,7 @@ void REPL::run()
         if(!Preprocessor::process(source, source, "", &preprocessorErrorPrinter)){
             continue;
         }
-        if(!Scanner::scan(source, tokens, functions, functionNames, &errorPrinter)){
+        if(!Scanner::scan(source, tokens, functions, functionNames, variableSlots, &errorPrinter)){
             continue;
         }
         if(!FunctionExtractor::extractFunctions(tokens, tokensRef)){
@@ -47,6 +48,7 @@ void REPL::run()
         }
         addFunctionNames(functionNames, functions);
         copyFunctions(functions, programState);
+        Scanner::bindFunctions(tokens, programState.functions);
         Value result;
         if(!interpreter.execute(tokensRef, programState, result)){
             continue;
@@ -106,13 +108,23 @@ void REPL::deleteFunction(Function& function)
 
 void REPL::copyFunctions(std::unordered_map<std::string, Function>& functions, ProgramState& programState)
 {
+    // every function has its place in the program state before the copies are bound to it,
+    // a redefined function keeps its place so earlier callers call the new definition
     for(auto& i: functions){
-        Function functionCopy = i.second;
         if(programState.functions.find(i.first) != programState.functions.end()){
             deleteFunction(programState.functions[i.first]);
+        }else{
+            programState.functions[i.first] = Function();
+        }
+    }
+
+    for(auto& i: functions){
+        Function functionCopy = i.second;
+        for(int i=0; i<functionCopy.body.size(); i++){
+            Token* token = new Token(*functionCopy.body[i]);
+            Scanner::bindFunction(*token, programState.functions);
+            functionCopy.body[i] = token;
         }
-        for(int i=0; i<functionCopy.body.size(); i++)
-            functionCopy.body[i] = new Token(*functionCopy.body[i]);
 
         programState.functions[i.first] = functionCopy;
     }
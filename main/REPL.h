@@ -7,7 +7,7 @@
 
 class REPL{
 public:
-    static void run();
+    static void run(InterpreterEngine engine);
 
 private:
     static std::string readInput(bool& isHelp, bool& isExit);
@@ -7,6 +7,10 @@
 #include "../reporting/ErrorPrinter.h"
 #include "../interpreter/InterpreterIO.h"
 #include "../interpreter/FunctionExtractor.h"
+#include "../interpreter/ThreadPool.h"
+#include "../interpreter/InterpreterCalculator.h"
+#include "../compiler/BytecodeCompiler.h"
+#include "../compiler/Optimizer.h"
 #include "../util/StringUtil.h"
 #include "REPL.h"
 
@@ -28,24 +32,162 @@ bool enterFilepath(std::string& filepath)
     return filepath.size() > 0;
 }
 
+// --engine=tokens|tree|bytecode, the tokens are interpreted directly unless another engine is picked
+bool parseEngine(const std::string& argument, InterpreterEngine& engine)
+{
+    const std::string prefix = "--engine=";
+    if(argument.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    const std::string name = argument.substr(prefix.size());
+    if(name == "tokens")
+        engine = InterpreterEngineTokens;
+    else if(name == "tree")
+        engine = InterpreterEngineSyntaxTree;
+    else if(name == "bytecode")
+        engine = InterpreterEngineBytecode;
+    else
+        return false;
+
+    return true;
+}
+
+// --threads=N, number of threads that run async blocks
+bool parseThreads(const std::string& argument)
+{
+    const std::string prefix = "--threads=";
+    if(argument.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    const int threads = std::atoi(argument.substr(prefix.size()).c_str());
+    if(threads <= 0)
+        return false;
+
+    ThreadPool::setSize(threads);
+    return true;
+}
+
+// --sum=fast|compensated, compensated sums add the rounding errors of #+ back
+bool parseSum(const std::string& argument)
+{
+    const std::string prefix = "--sum=";
+    if(argument.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    const std::string name = argument.substr(prefix.size());
+    if(name == "fast")
+        InterpreterCalculator::setCompensatedSum(false);
+    else if(name == "compensated")
+        InterpreterCalculator::setCompensatedSum(true);
+    else
+        return false;
+
+    return true;
+}
+
+// --fusion=on|off, runs of element wise operators are calculated element by element in the bytecode engine
+bool parseFusion(const std::string& argument)
+{
+    const std::string prefix = "--fusion=";
+    if(argument.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    const std::string name = argument.substr(prefix.size());
+    if(name == "on")
+        BytecodeCompiler::setFusion(true);
+    else if(name == "off")
+        BytecodeCompiler::setFusion(false);
+    else
+        return false;
+
+    return true;
+}
+
+// --counted=on|off, loops that step a variable to a limit compare and step its number in place in the bytecode engine
+bool parseCounted(const std::string& argument)
+{
+    const std::string prefix = "--counted=";
+    if(argument.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    const std::string name = argument.substr(prefix.size());
+    if(name == "on")
+        BytecodeCompiler::setCountedLoops(true);
+    else if(name == "off")
+        BytecodeCompiler::setCountedLoops(false);
+    else
+        return false;
+
+    return true;
+}
+
+// --memoize=on|off|stats, results of functions that only depend on their parameters are cached,
+// stats also writes the hits and misses of each memoized function when the program ends
+bool parseMemoize(const std::string& argument, bool& isMemoStatistics)
+{
+    const std::string prefix = "--memoize=";
+    if(argument.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    const std::string name = argument.substr(prefix.size());
+    if(name == "on" || name == "stats")
+        Interpreter::setMemoization(true);
+    else if(name == "off")
+        Interpreter::setMemoization(false);
+    else
+        return false;
+
+    isMemoStatistics = name == "stats";
+    return true;
+}
+
+// --optimize=on|off, constant subexpressions are folded and repeated parenthesis in a statement are calculated once
+bool parseOptimize(const std::string& argument)
+{
+    const std::string prefix = "--optimize=";
+    if(argument.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    const std::string name = argument.substr(prefix.size());
+    if(name == "on")
+        Optimizer::setOptimization(true);
+    else if(name == "off")
+        Optimizer::setOptimization(false);
+    else
+        return false;
+
+    return true;
+}
+
 int main(int argc, char** argv)
 {
     std::string source = "", filepath="";
+    InterpreterEngine engine = InterpreterEngineTokens;
+    bool isMemoStatistics = false;
 
-    if(argc <= 1){
+    for(int i=1; i<argc; i++){
+        const std::string argument = argv[i];
+        if(argument.compare(0, 2, "--") != 0){
+            filepath = argument;
+        }else if(!parseEngine(argument, engine) && !parseThreads(argument) && !parseSum(argument) && !parseFusion(argument) && !parseCounted(argument) &&
+            !parseOptimize(argument) && !parseMemoize(argument, isMemoStatistics)){
+            std::cout << "Unknown option:\"" << argument << "\"" << std::endl;
+            return 1;
+        }
+    }
+
+    if(filepath.size() == 0){
         if(!enterFilepath(filepath)){
             std::cout << "Filepath not entered" << std::endl;
             return 1;
         }
-    }else{
-        filepath = argv[1];
     }
 
     if(filepath == "REPL"){
         std::cout << "*Entered REPL mode*" << std::endl;
         std::cout << "Type \"exit\" to quit the program" << std::endl;
         std::cout << "Type \"help\" + operator to view a description of the operator" << std::endl;
-        REPL::run();
+        REPL::run(engine);
         return 0;
     }
 
@@ -73,13 +215,17 @@ int main(int argc, char** argv)
         return 1;
     }
     Value result;
-    Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io);
+    Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
     
     if(!interpreter.execute(executable, functions, result)){
         return 1;
     }
     
     printResult(result);
+    if(isMemoStatistics){
+        for(const auto& i: interpreter.getMemoStatistics())
+            std::cout << "Memoized " << i.first << ": " << i.second.hits << " hits, " << i.second.misses << " misses" << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -11,7 +11,8 @@ bool Scanner::scan(
     IScannerErrorReporter* errorReporter)
 {
     std::unordered_set<std::string> empty;
-    return scan(source, tokens, functions, empty, errorReporter);
+    std::unordered_map<std::string, int> variableSlots;
+    return scan(source, tokens, functions, empty, variableSlots, errorReporter);
 }
 
 bool Scanner::scan(
@@ -19,6 +20,7 @@ bool Scanner::scan(
     std::vector<Token>& tokens,
     std::unordered_map<std::string, Function>& functions,
     std::unordered_set<std::string>& previousFunctions,
+    std::unordered_map<std::string, int>& variableSlots,
     IScannerErrorReporter* errorReporter)
 {
     tokens.clear();
@@ -91,10 +93,44 @@ bool Scanner::scan(
     if(!extractFunctions(tokens, functions)){
         report(errorReporter, hadError, source, 0, ScannerErrorTypeFunctionDefinitionError);
     }
+    bindFunctions(tokens, functions);
+    bindVariables(tokens, variableSlots);
 
     return !hadError;
 }
 
+void Scanner::bindFunctions(std::vector<Token>& tokens, std::unordered_map<std::string, Function>& functions)
+{
+    for(auto& i: tokens)
+        bindFunction(i, functions);
+}
+
+void Scanner::bindVariables(std::vector<Token>& tokens, std::unordered_map<std::string, int>& variableSlots)
+{
+    for(auto& i: tokens){
+        if(i.id != TokenIdVariable)
+            continue;
+
+        const auto slot = variableSlots.find(i.str);
+        if(slot != variableSlots.end()){
+            i.slot = slot->second;
+        }else{
+            i.slot = variableSlots.size();
+            variableSlots[i.str] = i.slot;
+        }
+    }
+}
+
+void Scanner::bindFunction(Token& token, std::unordered_map<std::string, Function>& functions)
+{
+    if(token.id != TokenIdFunction)
+        return;
+
+    // functions defined in previous sources are bound by their owner
+    const auto function = functions.find(token.str);
+    token.function = function == functions.end() ? nullptr : &function->second;
+}
+
 bool Scanner::findFunctionNames(const std::string& source, std::unordered_set<std::string>& functionNames, IScannerErrorReporter* errorReporter)
 {
     functionNames.clear();
@@ -177,7 +213,7 @@ void Scanner::determineFunctionPrameters(Function& function)
     }
 }
 
-bool Scanner::extractFunctions(const std::vector<Token>& tokens, std::unordered_map<std::string, Function>& functions)
+bool Scanner::extractFunctions(std::vector<Token>& tokens, std::unordered_map<std::string, Function>& functions)
 {
     const int size = tokens.size();
     Function function;
@@ -202,6 +238,7 @@ bool Scanner::extractFunctions(const std::vector<Token>& tokens, std::unordered_
             if(function.body.size() <= 0)
                 return false;
             determineFunctionPrameters(function);
+            computeJumps(tokens, function, i+1);
             functions[functionName] = function;
             functionName = "";
             findOpen = false;
@@ -220,6 +257,15 @@ bool Scanner::extractFunctions(const std::vector<Token>& tokens, std::unordered_
     return true;
 }
 
+void Scanner::computeJumps(std::vector<Token>& tokens, const Function& function, int bodyStart)
+{
+    std::vector<int> jumps;
+    TokenSubArrayFinder::computeJumps(function.body, jumps);
+    const int size = jumps.size();
+    for(int i=0; i<size; i++)
+        tokens[bodyStart+i].jump = jumps[i];
+}
+
 bool Scanner::matchToken(
     const std::string& tokenString,
     std::vector<Token>& tokens,
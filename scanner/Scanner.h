@@ -18,17 +18,27 @@ public:
         std::unordered_map<std::string, Function>& functions,
         IScannerErrorReporter* errorReporter);
 
+    // variableSlots keeps the slots of variables of previous sources, new variables are added to it
     static bool scan(
         const std::string& source,
         std::vector<Token>& tokens,
         std::unordered_map<std::string, Function>& functions,
         std::unordered_set<std::string>& previousFunctions,
+        std::unordered_map<std::string, int>& variableSlots,
         IScannerErrorReporter* errorReporter);
+
+    // points the function tokens to their definitions, functions must outlive the tokens
+    static void bindFunctions(std::vector<Token>& tokens, std::unordered_map<std::string, Function>& functions);
+
+    static void bindFunction(Token& token, std::unordered_map<std::string, Function>& functions);
+
+    // gives every variable name a slot, in order of appearance
+    static void bindVariables(std::vector<Token>& tokens, std::unordered_map<std::string, int>& variableSlots);
         
 private:
     static bool findFunctionNames(const std::string& source, std::unordered_set<std::string>& functionNames, IScannerErrorReporter* errorReporter);
 
-    static bool extractFunctions(const std::vector<Token>& tokens, std::unordered_map<std::string, Function>& functions);
+    static bool extractFunctions(std::vector<Token>& tokens, std::unordered_map<std::string, Function>& functions);
     
     static void addNextToken(
         const std::string& tokenString,
@@ -58,6 +68,8 @@ private:
 
     static void determineFunctionPrameters(Function& function);
 
+    static void computeJumps(std::vector<Token>& tokens, const Function& function, int bodyStart);
+
     static bool validateParenthesis(const std::string& source, const int sourceLen, IScannerErrorReporter* errorReporter);
 
     static bool isIdentifierNextToSymbol(const std::string& source, int position);
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 #include "../scanner/Scanner.h"
 #include "../util/LiteralParser.h"
 #include "../util/StringUtil.h"
@@ -9,10 +11,53 @@
 #include "../interpreter/Interpreter.h"
 #include "../interpreter/FunctionExtractor.h"
 #include "../interpreter/InterpreterIO.h"
+#include "../interpreter/InterpreterCalculator.h"
+#include "../interpreter/ShardedLock.h"
+#include "../interpreter/ThreadPool.h"
+#include "../compiler/Compiler.h"
+#include "../compiler/BytecodeCompiler.h"
+#include "../compiler/Optimizer.h"
+#include "../scanner/Preprocessor.h"
+#include "../util/FileReader.h"
 
 ErrorPrinter errorPrinter;
 InterpreterIO io;
 
+// returns the same input for every read, keeps what is written
+class CountingReporter : public IRuntimeErrorReporter{
+public:
+    void report(const TokenRange&, int, RuntimeErrorType) override { reports++; }
+
+    void report(RuntimeErrorType) override { reports++; }
+
+    int reports = 0;
+};
+
+class RecordingIO : public IInterpreterIO{
+public:
+    explicit RecordingIO(const Value& input): input(input){}
+
+    std::unique_ptr<Value> read() override { return std::make_unique<Value>(input); }
+
+    void write(const Value& value) override { record(value); }
+
+    std::unique_ptr<Value> readText() override { return std::make_unique<Value>(input); }
+
+    void writeText(const Value& value) override { record(value); }
+
+    std::string output;
+
+private:
+    Value input;
+
+    void record(const Value& value)
+    {
+        std::string converted;
+        StringUtil::convertValueToString(value, converted);
+        output += converted + '\n';
+    }
+};
+
 void testLiteralParser(){
     Value lit;
 
@@ -45,6 +90,428 @@ void testLiteralParser(){
     assert(lit[0] == '\\');
 }
 
+void testValue(){
+    Value first = {1.0, 2.0, 3.0};
+    Value second = first;
+    assert(second.data() == first.data());
+
+    // the first mutation copies the shared numbers
+    second.push_back(4.0);
+    assert(second.data() != first.data());
+    assert(first.size() == 3);
+    assert(second.size() == 4);
+    assert(second[3] == 4.0);
+
+    Value third = first;
+    third.mutableData()[0] = 5.0;
+    assert(first[0] == 1.0);
+    assert(third[0] == 5.0);
+    assert(third != first);
+
+    third.clear();
+    assert(third.size() == 0);
+    assert(first == Value({1.0, 2.0, 3.0}));
+
+    // small values are stored inline and move to allocated storage when they grow
+    Value scalar = {7.0};
+    const double* inlineNumbers = scalar.data();
+    Value copy = scalar;
+    assert(copy.data() != inlineNumbers);
+    for(size_t i=0; i<Value::INLINE_CAPACITY; i++)
+        scalar.push_back(i);
+    assert(scalar.data() != inlineNumbers);
+    assert(scalar.size() == Value::INLINE_CAPACITY + 1);
+    assert(scalar[0] == 7.0);
+    assert(scalar.back() == Value::INLINE_CAPACITY - 1);
+    assert(copy == Value({7.0}));
+}
+
+void testCalculatorDestination(){
+    bool hadError = false;
+    Value left = {1.0, 2.0, 3.0};
+    const Value right = {1.0};
+    const double* numbers = left.data();
+
+    // an unshared parameter of the result size is reused
+    InterpreterCalculator::add(left, right, left, hadError, nullptr);
+    assert(!hadError);
+    assert(left.data() == numbers);
+    assert(left == Value({2.0, 3.0, 4.0}));
+
+    // shared numbers are copied first
+    const Value shared = left;
+    InterpreterCalculator::multiply(left, left, left, hadError, nullptr);
+    assert(left == Value({4.0, 9.0, 16.0}));
+    assert(shared == Value({2.0, 3.0, 4.0}));
+
+    // a broadcast scalar can't hold the result
+    Value scalar = {2.0};
+    InterpreterCalculator::subtract(scalar, shared, scalar, hadError, nullptr);
+    assert(scalar == Value({0.0, -1.0, -2.0}));
+
+    InterpreterCalculator::sumAll(scalar, scalar, hadError, nullptr);
+    assert(scalar == Value({-3.0}));
+    assert(!hadError);
+}
+
+void testBroadcast(){
+    bool hadError = false;
+    const Value five = {1.0, 2.0, 3.0, 4.0, 5.0};
+    const Value two = {10.0, 20.0};
+
+    // the shorter parameter repeats
+    Value result;
+    InterpreterCalculator::add(five, two, result, hadError, nullptr);
+    assert(result == Value({11.0, 22.0, 13.0, 24.0, 15.0}));
+    InterpreterCalculator::subtract(two, five, result, hadError, nullptr);
+    assert(result == Value({9.0, 18.0, 7.0, 16.0, 5.0}));
+    InterpreterCalculator::lessThan(five, {3.0}, result, hadError, nullptr);
+    assert(result == Value({1.0, 1.0, 0.0, 0.0, 0.0}));
+    InterpreterCalculator::mod({7.0}, five, result, hadError, nullptr);
+    assert(result == Value({0.0, 1.0, 1.0, 3.0, 2.0}));
+    assert(!hadError);
+
+    // errors are found before or after the calculation and reported by the element wise one
+    InterpreterCalculator::divide(five, {1.0, 0.0}, result, hadError, nullptr);
+    assert(hadError);
+    hadError = false;
+    InterpreterCalculator::mod(five, {2.0, 0.5}, result, hadError, nullptr);
+    assert(hadError);
+    hadError = false;
+    InterpreterCalculator::power({-1.0, 4.0, 9.0}, {0.5}, result, hadError, nullptr);
+    assert(hadError);
+    hadError = false;
+    InterpreterCalculator::power({0.0, 4.0, 9.0}, {0.5}, result, hadError, nullptr);
+    assert(result == Value({0.0, 2.0, 3.0}));
+    assert(!hadError);
+}
+
+void testReductions(){
+    bool hadError = false;
+    Value tenths;
+    tenths.resize(1000000, 0.1);
+
+    // the blocks are combined in the same order for any number of tasks
+    Value sequential, parallel;
+    InterpreterCalculator::setReductionTasks(1);
+    InterpreterCalculator::sumAll(tenths, sequential, hadError, nullptr);
+    InterpreterCalculator::setReductionTasks(4);
+    InterpreterCalculator::sumAll(tenths, parallel, hadError, nullptr);
+    InterpreterCalculator::setReductionTasks(0);
+    assert(sequential == parallel);
+
+    // the compensated sum rounds once
+    Value compensated;
+    InterpreterCalculator::setCompensatedSum(true);
+    InterpreterCalculator::sumAll(tenths, compensated, hadError, nullptr);
+    InterpreterCalculator::setCompensatedSum(false);
+    assert(compensated[0] == 100000.0);
+    assert(std::abs(parallel[0] - 100000.0) < 1e-6);
+
+    Value text = Value::makeCharacters(std::string(500000, 'a').c_str(), 500000);
+    InterpreterCalculator::sumAll(text, text, hadError, nullptr);
+    assert(text == Value({500000.0 * 'a'}));
+
+    Value halves;
+    halves.resize(300000, 0.5);
+    InterpreterCalculator::multiplyAll(halves, halves, hadError, nullptr);
+    assert(halves == Value({0.0}));
+    assert(!hadError);
+
+    // numbers are multiplied left to right, a 0 first keeps the product 0 although the others overflow
+    Value factors;
+    factors.resize(400, 1e300);
+    factors.mutableData()[0] = 0.0;
+    InterpreterCalculator::multiplyAll(factors, factors, hadError, nullptr);
+    assert(factors == Value({0.0}));
+
+    // large products are multiplied in blocks, which are combined in the same order for any number of tasks,
+    // unless a running product leaves the normal numbers, then the product is the one of the sequential loop
+    Value nearOne;
+    nearOne.resize(1000000, 1.0000001);
+    InterpreterCalculator::setReductionTasks(1);
+    InterpreterCalculator::multiplyAll(nearOne, sequential, hadError, nullptr);
+    InterpreterCalculator::setReductionTasks(4);
+    InterpreterCalculator::multiplyAll(nearOne, parallel, hadError, nullptr);
+    InterpreterCalculator::setReductionTasks(0);
+    assert(sequential == parallel);
+    assert(std::abs(parallel[0] - std::exp(1000000 * std::log1p(1e-7))) < 1e-9);
+
+    Value overflowing;
+    overflowing.resize(300000, 1.0);
+    overflowing.mutableData()[0] = 1e300;
+    overflowing.mutableData()[100000] = 1e300;
+    overflowing.mutableData()[200000] = 1e-300;
+    InterpreterCalculator::multiplyAll(overflowing, overflowing, hadError, nullptr);
+    assert(overflowing == Value({INFINITY}));
+
+    factors.resize(300000, 1e300);
+    factors.mutableData()[0] = 0.0;
+    InterpreterCalculator::multiplyAll(factors, factors, hadError, nullptr);
+    assert(factors == Value({0.0}));
+
+    // sums below the parallel size are added in order, so an overflow stays inf instead of cancelling out in lanes
+    const double B = 1e308;
+    const Value cancelling({B, B, 0, 0, 0, 0, 0, 0, -B, -B, 0, 0, 0, 0, 0, 0});
+    Value overflow;
+    InterpreterCalculator::sumAll(cancelling, overflow, hadError, nullptr);
+    assert(overflow == Value({INFINITY}));
+
+    // the compensation stops once the sum overflows, inf - inf would make it NaN
+    InterpreterCalculator::setCompensatedSum(true);
+    InterpreterCalculator::sumAll(cancelling, overflow, hadError, nullptr);
+    assert(overflow == Value({INFINITY}));
+    InterpreterCalculator::sumAll(Value({B, B}), overflow, hadError, nullptr);
+    assert(overflow == Value({INFINITY}));
+    Value large;
+    large.resize(1000000, B);
+    InterpreterCalculator::sumAll(large, overflow, hadError, nullptr);
+    assert(overflow == Value({INFINITY}));
+    InterpreterCalculator::setCompensatedSum(false);
+
+    // the product of a % (a - 2 i + 1) is 0 for composites above 170, whose factors overflow before the divisor
+    const std::string source =
+        "f ISPRIME {\n    ( a % (a - 2 i + 1) #* != 0 ) + (a == 2)\n}\n"
+        "(289 ISPRIME) | (329 ISPRIME) | (343 ISPRIME) | (391 ISPRIME) | (389 ISPRIME) | (1000 i \\ ISPRIME #+) | (2000 i \\ ISPRIME #+)";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+    for(const auto engine: {InterpreterEngineTokens, InterpreterEngineSyntaxTree, InterpreterEngineBytecode}){
+        Value primes;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
+        assert(interpreter.execute(exec, functions, primes));
+        assert(primes == Value({0.0, 0.0, 0.0, 0.0, 1.0, 168.0, 303.0}));
+    }
+}
+
+void testSort(){
+    bool hadError = false;
+
+    // enough numbers to be sorted in runs on the thread pool and merged
+    Value numbers;
+    const size_t size = (1 << 20) + 3;
+    numbers.reserve(size);
+    unsigned long long seed = 12345;
+    for(size_t i=0; i<size; i++){
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        numbers.push_back((double)(long long)(seed >> 20) / 1000.0);
+    }
+    numbers.mutableData()[10] = -0.0;
+    numbers.mutableData()[11] = NAN;
+    numbers.mutableData()[12] = -INFINITY;
+    std::vector<double> expected(numbers.begin(), numbers.end());
+
+    InterpreterCalculator::sortArray(numbers, numbers, hadError, nullptr);
+    assert(!hadError);
+    assert(numbers.size() == size);
+    assert(numbers[0] == -INFINITY);
+    assert(std::isnan(numbers.back()));
+    expected.erase(expected.begin() + 11);
+    std::sort(expected.begin(), expected.end());
+    assert(std::equal(expected.begin(), expected.end(), numbers.begin()));
+
+    // characters are counted, ranges are reversed
+    Value text = Value::makeCharacters("sorted text", 11);
+    InterpreterCalculator::sortArray(text, text, hadError, nullptr);
+    assert(text.type() == ValueTypeCharacter);
+    assert(text == Value::makeCharacters(" deeorstttx", 11));
+
+    Value range = Value::makeRange(10.0, -2.0, 4);
+    InterpreterCalculator::sortArray(range, range, hadError, nullptr);
+    assert(range.isRange());
+    assert(range == Value({4.0, 6.0, 8.0, 10.0}));
+}
+
+void testSetOperators(){
+    bool hadError = false;
+
+    // -0 is 0 and the NaNs are one number
+    Value numbers({3.0, -0.0, NAN, 0.0, 3.0, NAN, 1.5});
+    Value set;
+    InterpreterCalculator::makeSet(numbers, set, hadError, nullptr);
+    assert(set.size() == 4);
+    assert(set[0] == 3.0 && set[1] == 0.0 && std::signbit(set[1]) && std::isnan(set[2]) && set[3] == 1.5);
+
+    Value counts;
+    InterpreterCalculator::countEach(numbers, {0.0, NAN, 2.0}, counts, hadError, nullptr);
+    assert(counts == Value({2.0, 2.0, 0.0}));
+
+    // enough numbers on both sides to be hashed, small integers are looked up directly
+    for(double offset: {0.5, 0.0}){
+        Value many;
+        for(int i=0; i<1000; i++)
+            many.push_back(i % 300 + offset);
+        Value odd;
+        for(int i=1; i<300; i+=2)
+            odd.push_back(i + offset);
+        Value kept;
+        InterpreterCalculator::remain(many, odd, kept, hadError, nullptr);
+        assert(kept.size() == 500 && kept[0] == 1.0 + offset && kept[1] == 3.0 + offset);
+        InterpreterCalculator::remove(many, odd, kept, hadError, nullptr);
+        assert(kept.size() == 500 && kept[0] == offset && kept[1] == 2.0 + offset);
+        InterpreterCalculator::remove(odd, many, kept, hadError, nullptr);
+        assert(kept == Value({0.0}));
+        InterpreterCalculator::makeSet(many, set, hadError, nullptr);
+        assert(set.size() == 300 && set[299] == 299.0 + offset);
+        InterpreterCalculator::countEach(many, {offset, 299.0 + offset, 300.0 + offset}, counts, hadError, nullptr);
+        assert(counts == Value({4.0, 3.0, 0.0}));
+    }
+
+    // numbers outside the domain of the integers aren't found
+    Value letters({'a', 'b', 'c', 'a', 'c'});
+    Value found;
+    InterpreterCalculator::remain({96.0, 97.0, 97.5, -97.0, 1e300, NAN, 99.0}, letters, found, hadError, nullptr);
+    assert(found == Value({97.0, 99.0}));
+    InterpreterCalculator::countEach(letters, {97.0, 97.5, -1.0, 1000.0, 99.0}, counts, hadError, nullptr);
+    assert(counts == Value({2.0, 0.0, 0.0, 0.0, 2.0}));
+    InterpreterCalculator::makeSet({-0.0, 2.0, 0.0, 2.0, 1.0}, set, hadError, nullptr);
+    assert(set == Value({0.0, 2.0, 1.0}) && std::signbit(set[0]));
+    assert(!hadError);
+}
+
+void testRange(){
+    bool hadError = false;
+    Value range;
+    InterpreterCalculator::iterate({1000000000.0}, range, hadError, nullptr);
+    assert(range.isRange());
+    assert(range.size() == 1000000000);
+    assert(range[41] == 42.0);
+
+    // closed forms keep the range
+    InterpreterCalculator::sumAll(range, range, hadError, nullptr);
+    assert(range == Value({500000000500000000.0}));
+
+    InterpreterCalculator::iterate({5.0}, range, hadError, nullptr);
+    InterpreterCalculator::multiply(range, {2.0}, range, hadError, nullptr);
+    InterpreterCalculator::subtract({20.0}, range, range, hadError, nullptr);
+    assert(range.isRange());
+    InterpreterCalculator::reverseArray(range, range, hadError, nullptr);
+    assert(range.isRange());
+
+    // numbers that wouldn't stay exact integers are stored
+    Value half;
+    InterpreterCalculator::multiply(range, {0.5}, half, hadError, nullptr);
+    assert(!half.isRange());
+    assert(half == Value({5.0, 6.0, 7.0, 8.0, 9.0}));
+
+    // reading the numbers stores them
+    assert(range.isRange());
+    assert(range == Value({10.0, 12.0, 14.0, 16.0, 18.0}));
+    assert(!range.isRange());
+
+    Value selected;
+    InterpreterCalculator::select(range, {2.0, 9.0, 5.0}, selected, hadError, nullptr);
+    assert(selected == Value({12.0, 18.0}));
+    assert(!hadError);
+}
+
+void testTypedValue(){
+    bool hadError = false;
+    Value text;
+    assert(LiteralParser::parseString("\"a b c\"", text));
+    assert(text.type() == ValueTypeCharacter);
+    assert(text.size() == 5);
+    assert(text[1] == ' ');
+
+    // comparisons give booleans, arithmetic promotes to numbers
+    Value spaces;
+    InterpreterCalculator::equals(text, {' '}, spaces, hadError, nullptr);
+    assert(spaces.type() == ValueTypeBoolean);
+    assert(spaces[0] == 0.0 && spaces[1] == 1.0);
+    Value sum;
+    InterpreterCalculator::sumAll(spaces, sum, hadError, nullptr);
+    assert(sum == Value({2.0}));
+    InterpreterCalculator::add(spaces, {1.0}, spaces, hadError, nullptr);
+    assert(spaces.type() == ValueTypeNumber);
+    assert(spaces == Value({1.0, 2.0, 1.0, 2.0, 1.0}));
+
+    // filtering keeps the bytes
+    Value letters;
+    InterpreterCalculator::remove(text, {' '}, letters, hadError, nullptr);
+    assert(letters.type() == ValueTypeCharacter);
+    assert(letters == Value({'a', 'b', 'c'}));
+    assert(text.type() == ValueTypeCharacter);
+
+    // small values stay inline numbers
+    Value small;
+    assert(LiteralParser::parseString("\"ab\"", small));
+    assert(small.type() == ValueTypeNumber);
+    assert(!hadError);
+
+    // at most 2 selected or kept characters stay bytes, they are widened to inline numbers when written as numbers
+    Value selected;
+    InterpreterCalculator::select(text, {0.0, 2.0, 2.0}, selected, hadError, nullptr);
+    assert(selected.size() <= 2);
+    InterpreterCalculator::findRound(selected, selected, hadError, nullptr);
+    Value shrunk = text;
+    shrunk.resize(2);
+    shrunk.reserve(2);
+    assert(shrunk == Value({'a', ' '}));
+    shrunk = text;
+    shrunk.resize(1);
+    shrunk.mutableData()[0] += 1;
+    assert(shrunk == Value({'b'}));
+    assert(!hadError);
+
+    for(const std::string source: {"\"hello\" : 0,2,2 ~", "\"hello\" : 0,2,2 ^", "\"hello\" : 0,2,2 !"}){
+        std::vector<Token> tokens;
+        std::unordered_map<std::string, Function> functions;
+        assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+        std::vector<const Token*> exec;
+        assert(FunctionExtractor::extractFunctions(tokens, exec));
+        for(const auto engine: {InterpreterEngineTokens, InterpreterEngineSyntaxTree, InterpreterEngineBytecode}){
+            Value result;
+            Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
+            assert(interpreter.execute(exec, functions, result));
+        }
+    }
+}
+
+void testShardedLock(){
+    ShardedLock lock;
+    int counter = 0;
+    std::vector<std::thread> threads;
+    for(int i=0; i<4; i++){
+        threads.push_back(std::thread([&lock, &counter](){
+            for(int j=0; j<1000; j++){
+                lock.lock();
+                counter++;
+                lock.unlock();
+
+                lock.lockShared();
+                assert(counter > 0);
+                lock.unlockShared();
+            }
+        }));
+    }
+    for(auto& i: threads)
+        i.join();
+
+    assert(counter == 4000);
+}
+
+void testThreadPool(){
+    // more workers than cores, so tasks wait for each other concurrently
+    ThreadPool::setSize(4);
+    ThreadPool& pool = ThreadPool::getInstance();
+    TaskGroup group;
+    std::atomic<int> counter{0};
+    for(int i=0; i<100; i++){
+        pool.submit(group, [&pool, &group, &counter](){
+            // tasks that wait for their own group don't wait for each other
+            pool.submit(group, [&counter](){ counter++; });
+            pool.wait(group);
+            counter++;
+        });
+    }
+    pool.wait(group);
+
+    assert(counter == 200);
+    assert(group.pending == 0);
+}
+
 void testStringUtil(){
     assert(StringUtil::isValidIdentifierName("MYVAR"));
     assert(StringUtil::isValidIdentifierName("MYFUNC1"));
@@ -57,6 +524,142 @@ void testStringUtil(){
 
 
 
+void testJumpTargets(){
+    std::string source = "f F { (a + 1) }\nif 1 {\n A = (2 * (3))\n}\n[w 4]\n";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    // \n if 1 { \n A = ( 2 * ( 3 ) ) \n } \n [ w 4 ] \n
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 1) == 3);
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 3) == 15);
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 6) == 14);
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 7) == 13);
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 10) == 12);
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 17) == 20);
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 18) == 21);
+
+    const TokenRange statement = TokenRange(exec).subRange(6, 10);
+    assert(statement.size() == 5);
+    assert(TokenSubArrayFinder::findJumpTarget(statement, 0) == 4);
+    assert(TokenSubArrayFinder::findJumpTarget(statement, 1) == TokenSubArrayFinder::TOKEN_INDEX_NOT_FOUND);
+    assert(TokenSubArrayFinder::findJumpTarget(exec, 7) == TokenSubArrayFinder::findClosingParenthesis(exec, 7));
+
+    const auto& body = functions["F"].body;
+    assert(TokenSubArrayFinder::findJumpTarget(body, 0) == 4);
+}
+
+void testCompiler(){
+    std::string source = "f F { a + 1 }\nA = 2 F * 3\ndo A < 10 {\n A = A + 1\n}\n5 if 1 { + 1 }";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    std::unordered_map<std::string, SyntaxBlock> compiledFunctions;
+    Compiler::compileFunctions(functions, compiledFunctions);
+    assert(compiledFunctions["F"].isCompiled);
+    assert(compiledFunctions["F"].statements.size() == 1);
+    assert(compiledFunctions["F"].statements[0].type == SyntaxNodeOperation);
+
+    // \n A = 2 F * 3 \n
+    SyntaxBlock block;
+    Compiler::compile(TokenRange(exec).subRange(0, 7), functions, compiledFunctions, block);
+    assert(block.isCompiled);
+    assert(block.statements.size() == 1);
+    const SyntaxNode& assign = block.statements[0];
+    assert(assign.type == SyntaxNodeAssign);
+    assert(assign.token->str == "A");
+    const SyntaxNode& multiply = assign.block->statements[0];
+    assert(multiply.type == SyntaxNodeOperation);
+    assert(multiply.token->id == TokenIdMultiply);
+    assert(multiply.children[0].type == SyntaxNodeOperation);
+    assert(multiply.children[0].function == &compiledFunctions["F"]);
+    assert(multiply.children[1].type == SyntaxNodeLiteral);
+
+    // '5' is the left parameter of '+' in the if body, the whole program is left to the token interpreter
+    Compiler::compile(exec, functions, compiledFunctions, block);
+    assert(!block.isCompiled);
+    Compiler::compile(TokenRange(exec).subRange(0, 21), functions, compiledFunctions, block);
+    assert(block.isCompiled);
+    assert(block.statements[1].type == SyntaxNodeLoop);
+    assert(block.statements[1].children.size() == 1);
+
+    // A < 10 with A = A + 1 in the body is a counted loop
+    BytecodeBlock bytecode;
+    std::unordered_map<std::string, BytecodeBlock> bytecodeFunctions;
+    BytecodeCompiler::compileFunctions(compiledFunctions, bytecodeFunctions);
+    BytecodeCompiler::compile(block, compiledFunctions, bytecodeFunctions, bytecode);
+    assert(bytecode.countedLoops.size() == 1);
+    assert(bytecode.countedLoops[0]->comparison == OpcodeLessThan);
+    assert(bytecode.countedLoops[0]->step == 1.0);
+}
+
+void testOptimizer(){
+    std::string source =
+        "f UPPER { a + (\"A\" - \"a\") }\n"
+        "f MASK { a : (3 i + b - 1) }\n"
+        "f RANGE { ((b - a)i + a) : (((b - a)i + a) * 2 > 5) }\n"
+        "f RANDOM { (3 ?) + (3 ?) }\n"
+        "f WRITES { (X + 1) + (X INC) + (X + 1) }\n"
+        "f INC { X = X + 1; a }\n";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::unordered_map<std::string, SyntaxBlock> compiledFunctions;
+    Compiler::compileFunctions(functions, compiledFunctions);
+    Optimizer::optimizeFunctions(compiledFunctions);
+
+    // operators on literals are folded into one literal
+    const SyntaxNode& upper = compiledFunctions["UPPER"].statements[0];
+    assert(upper.children[1].type == SyntaxNodeLiteral);
+    assert(upper.children[1].token->val.size() == 1);
+    assert(upper.children[1].token->val[0] == 'A' - 'a');
+    const SyntaxNode& mask = compiledFunctions["MASK"].statements[0].children[1].block->statements[0];
+    assert(mask.children[0].children[0].type == SyntaxNodeLiteral);
+    assert(mask.children[0].children[0].token->val.size() == 3);
+
+    // the repeated parenthesis of a and b share a slot, the one in the comparison is only evaluated once
+    const SyntaxNode& range = compiledFunctions["RANGE"].statements[0];
+    assert(range.commonValues == 1);
+    assert(range.children[0].common == 0);
+    const SyntaxNode& compared = range.children[1].block->statements[0].children[0].children[0];
+    assert(compared.type == SyntaxNodeGroup && compared.common == 0);
+
+    // random numbers and variables written by a call aren't reused
+    assert(compiledFunctions["RANDOM"].statements[0].commonValues == 0);
+    assert(compiledFunctions["WRITES"].statements[0].commonValues == 0);
+
+    source =
+        "f LOOP {\n"
+        "    I = 0\n"
+        "    do I < (a - 1) {\n"
+        "        S = S + (a * 2) + (N + 1) + (I + 1) + (I INC)\n"
+        "        I = I + 1\n"
+        "    }\n"
+        "}\n"
+        "f INC { X = X + 1; a }\n";
+    tokens.clear();
+    functions.clear();
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    Compiler::compileFunctions(functions, compiledFunctions);
+    Optimizer::optimizeFunctions(compiledFunctions);
+
+    // parenthesis of a, b and variables the loop doesn't assign are invariant
+    const SyntaxNode& loop = compiledFunctions["LOOP"].statements[1];
+    assert(loop.type == SyntaxNodeLoop);
+    assert(loop.invariantValues == 3);
+    assert(loop.block->statements[0].children[1].isInvariant);
+    const SyntaxNode& sum = loop.children[0].block->statements[0];
+    assert(sum.children[0].children[0].children[0].children[1].isInvariant);
+    assert(sum.children[0].children[0].children[1].isInvariant);
+    assert(!sum.children[0].children[1].isInvariant);
+    assert(!sum.children[1].isInvariant);
+}
+
 void testScanner1(){
     std::string source = "f FUNC { a + 1,2,3 }\nA = 2,1 FUNC ";
     std::vector<Token> tokens;
@@ -82,6 +685,9 @@ void testScanner1(){
     assert(tokens[10].id == TokenIdLiteral);
     assert(tokens[10].val.size() == 2);
     assert(tokens[11].id == TokenIdFunction);
+    assert(tokens[11].function == &functions["FUNC"]);
+    assert(tokens[1].function == &functions["FUNC"]);
+    assert(tokens[8].function == nullptr);
 
     std::vector<const Token*> exec;
     assert(FunctionExtractor::extractFunctions(tokens, exec));
@@ -119,6 +725,11 @@ void testScanner2(){
     assert(tokens[11].id == TokenIdAdd);
     assert(tokens[12].id == TokenIdVariable);
     assert(tokens[13].id == TokenIdEndLine);
+
+    // every name has one slot
+    assert(tokens[0].slot == 0 && tokens[4].slot == 1 && tokens[8].slot == 2);
+    assert(tokens[10].slot == tokens[0].slot);
+    assert(tokens[12].slot == tokens[4].slot);
 }
 
 void testInterpreter1()
@@ -445,10 +1056,379 @@ void testInterpreter14()
     assert(result[0] == 1);
 }
 
+void testInterpreter15()
+{
+    std::string source = 
+        "f EMPTY { if a > 10 { a }\n}\n"
+        "I = 0; R = 0\n"
+        "do I < 3 {\n"
+        "   I = I + 1\n"
+        "   I EMPTY\n"
+        "   R = R + I\n"
+        "}\n"
+        "R + (5 EMPTY)";
+
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    // empty results are left to the token interpreter, which ignores them until the loop ends
+    Value result;
+    Interpreter interpreter(nullptr, (IInterpreterIO*)&io);
+    assert(!interpreter.execute(exec, functions, result));
+
+    std::vector<const Token*> loop(exec.begin(), exec.end() - 7);
+    assert(interpreter.execute(loop, functions, result));
+    assert(result.size() == 1);
+    assert(result[0] == 6);
+}
+
+void testInterpreter16()
+{
+    std::string source = 
+        "f SQUARE { a * a }\n"
+        "I = 0; R = 0\n"
+        "do I < 5 {\n"
+        "   I = I + 1\n"
+        "   if I % 2 == 1 {\n"
+        "       R = R + (I SQUARE)\n"
+        "   }\n"
+        "}\n"
+        "R + (1,2,3 \\ SQUARE)";
+
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    // every engine gives the result of the token interpreter
+    const InterpreterEngine engines[] = {InterpreterEngineTokens, InterpreterEngineSyntaxTree, InterpreterEngineBytecode};
+    for(const auto engine: engines){
+        Value result;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
+        assert(interpreter.execute(exec, functions, result));
+        assert(result.size() == 3);
+        assert(result[0] == 36);
+        assert(result[1] == 39);
+        assert(result[2] == 44);
+    }
+}
+
+void testInterpreter17()
+{
+    std::string source = 
+        "f HALF { a / 2 }\n"
+        "f NEXT { (a HALF) + b }\n"
+        "f COUNT {\n"
+        "   C = C + 1\n"
+        "   a\n"
+        "}\n"
+        "C = 0\n"
+        "R = 10000 i \\ NEXT\n"
+        "X = 5000 i \\ COUNT\n"
+        "R #+ + C + (R # * 100000000)";
+
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    // pure functions run in chunks on the thread pool, the function with an assignment runs in order
+    const InterpreterEngine engines[] = {InterpreterEngineTokens, InterpreterEngineSyntaxTree, InterpreterEngineBytecode};
+    for(const auto engine: engines){
+        Value result;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
+        assert(interpreter.execute(exec, functions, result));
+        assert(result.size() == 1);
+        assert(result[0] == 75007499 + 5000 + 10000 * 100000000.0);
+    }
+
+    // the results before the element that fails are kept and its errors are reported once, in chunks or in order
+    const std::string inverse = "f INVERSE {\n    1 / a\n}\nX = 8000 i % 1000\nX \\ INVERSE #+";
+    const std::string ordered = "f INVERSE {\n    V = 0\n    1 / a\n}\nX = 8000 i % 1000\nX \\ INVERSE #+";
+    for(const auto engine: engines){
+        Value results[2];
+        int reports[2];
+        for(int i=0; i<2; i++){
+            std::vector<Token> failingTokens;
+            std::unordered_map<std::string, Function> failingFunctions;
+            assert(Scanner::scan(i == 0 ? inverse : ordered, failingTokens, failingFunctions, &errorPrinter));
+            std::vector<const Token*> failingExec;
+            assert(FunctionExtractor::extractFunctions(failingTokens, failingExec));
+
+            CountingReporter reporter;
+            Interpreter interpreter(&reporter, (IInterpreterIO*)&io, engine);
+            assert(interpreter.execute(failingExec, failingFunctions, results[i]));
+            reports[i] = reporter.reports;
+        }
+        assert(results[0] == results[1]);
+        assert(std::abs(results[0][0] - 7.48447) < 1e-5);
+        assert(reports[0] == reports[1]);
+        assert(reports[0] > 0);
+    }
+}
+
+void testInterpreter18()
+{
+    std::string source = 
+        "T = \"hello world\"\n"
+        "(T \\ ==) #+ + (1000 i \\ + #+) + (1.5,2.5 \\ _ #+)";
+
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    // built-in operators run once over the array and its neighbours
+    const InterpreterEngine engines[] = {InterpreterEngineTokens, InterpreterEngineSyntaxTree, InterpreterEngineBytecode};
+    for(const auto engine: engines){
+        Value result;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
+        assert(interpreter.execute(exec, functions, result));
+        assert(result.size() == 1);
+        assert(result[0] == 1 + 1000999 + 3);
+    }
+}
+
+void testInterpreter19()
+{
+    const std::string prefix =
+        "X = 5000 i * 1.5 + 0\n"
+        "T = \"the quick brown fox jumps over the lazy dog \" : (5000 i % 44 + 1)\n";
+    const std::string expressions[] = {
+        "(X % 2 == 0) * X #+",
+        "X * 2 - 1 / 3 < 5000 #+",
+        "X - 1 * X #",
+        "X ** 0.5 + (X * 2) #*",
+        "X * 2 + X - (a + 1)",
+        "X * 3 > 100 * X",
+        "T == \"o\" * 2 + T #+",
+        "(T != \" \") * 1.5 + 1 #+"
+    };
+
+    // fused runs give the result of the operators, with the same type
+    for(const auto& expression: expressions){
+        std::vector<Token> tokens;
+        std::unordered_map<std::string, Function> functions;
+        assert(Scanner::scan(prefix + expression, tokens, functions, &errorPrinter));
+        std::vector<const Token*> exec;
+        assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+        Value expected;
+        Interpreter tokenInterpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, InterpreterEngineTokens);
+        assert(tokenInterpreter.execute(exec, functions, expected));
+        Value result;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, InterpreterEngineBytecode);
+        assert(interpreter.execute(exec, functions, result));
+        assert(result.type() == expected.type());
+        assert(result == expected);
+    }
+
+    // a division by zero falls back to the operators, which report it
+    std::string source = prefix + "X / (X - 1.5) #+";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+    for(const bool isFusion: {true, false}){
+        BytecodeCompiler::setFusion(isFusion);
+        Value result;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, InterpreterEngineBytecode);
+        assert(!interpreter.execute(exec, functions, result));
+    }
+}
+
+void testInterpreter20()
+{
+    const std::string examples[] = {
+        "examples/primes.txt",
+        "examples/async_primes.txt",
+        "examples/rule110.txt",
+        "examples/fizzbuzz.txt",
+        "examples/factorial.txt",
+        "examples/sum_of_even.txt",
+        "examples/primes_from_entered.txt",
+        "examples/include_main.txt",
+        "examples/word_count.txt"
+    };
+    const Value inputs[] = {{30.0}, {60.0, 3.0, 3.0, 8.0}};
+
+    // optimized programs write and return what the token interpreter does
+    for(const auto& filepath: examples){
+        std::string source;
+        assert(FileReader::read(filepath, source));
+        assert(Preprocessor::process(source, source, filepath, &errorPrinter));
+        std::vector<Token> tokens;
+        std::unordered_map<std::string, Function> functions;
+        assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+        std::vector<const Token*> exec;
+        assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+        for(const auto& input: inputs){
+            RecordingIO expectedIO(input);
+            Value expected;
+            Interpreter tokenInterpreter((IRuntimeErrorReporter*)&errorPrinter, &expectedIO, InterpreterEngineTokens);
+            assert(tokenInterpreter.execute(exec, functions, expected));
+
+            for(const auto engine: {InterpreterEngineSyntaxTree, InterpreterEngineBytecode}){
+                for(const bool isOptimization: {false, true}){
+                    Optimizer::setOptimization(isOptimization);
+                    RecordingIO recordingIO(input);
+                    Value result;
+                    Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, &recordingIO, engine);
+                    assert(interpreter.execute(exec, functions, result));
+                    assert(recordingIO.output == expectedIO.output);
+                    assert(result == expected);
+                }
+            }
+        }
+    }
+
+    // repeated and invariant parenthesis in loops, after calls that write their variables and around empty values
+    std::string source =
+        "f INC { C = C + 1; a }\n"
+        "f SPLIT { ((b - a) i + a) | (((b - a) i + a) -> (a + 1)) }\n"
+        "C = 1; R = 0\n"
+        "do C < 6 {\n"
+        "    R = R | ((C * 3 - 1) + (C * 3 - 1))\n"
+        "    R = R | ((C * 2) + (1 INC) + (C * 2))\n"
+        "}\n"
+        "R | (1 SPLIT 2) | (3 SPLIT 5) | ((1,1 -> 1) # + 2) | ((1,1 -> 1) # + 2)\n"
+        "f DEC { N = N - 1; a }\n"
+        "N = 10; I = 0; S = 0\n"
+        "do I < (N + 0) {\n"
+        "    S = S + (N * 2) + (I DEC)\n"
+        "    I = I + 1\n"
+        "}\n"
+        "do (I + 0) < (N + 10) {\n"
+        "    if (N * 3) > 0 {\n"
+        "        S = S | (N * 3)\n"
+        "    }\n"
+        "    I = I + 1\n"
+        "}\n"
+        "R | S";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    Value expected;
+    Interpreter tokenInterpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, InterpreterEngineTokens);
+    assert(tokenInterpreter.execute(exec, functions, expected));
+    for(const auto engine: {InterpreterEngineSyntaxTree, InterpreterEngineBytecode}){
+        Value result;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
+        assert(interpreter.execute(exec, functions, result));
+        assert(result == expected);
+    }
+}
+
+void testInterpreter21()
+{
+    // counted loops give what the token interpreter does when their variables aren't single numbers
+    std::string source =
+        "f TWICE {\n    I = I * 2\n    a\n}\n"
+        "I = 1\nS = 0\n"
+        "do I <= 20 {\n    S = S + I\n    I = I + 1\n}\n"
+        "I = 1\nN = 50\n"
+        "do I < N {\n    W = (0 TWICE)\n    N = N - 1\n    I = I + 3\n}\n"
+        "S = S | I | N\n"
+        "J = 10\n"
+        "do J >= 0 {\n    S = S | J\n    J = J - 2.5\n}\n"
+        "C = \"a\"\n"
+        "do C < 100 {\n    S = S | C\n    C = C + 1\n}\n"
+        "do U < 3 {\n    S = S | U\n    U = U + 1\n}\n"
+        "K = 1,2\n"
+        "do K > 0 {\n    S = S | K\n    K = K - 1\n}\n"
+        "R = 3 i\n"
+        "do R < 3 {\n    R = R + 1\n}\n"
+        "L = 0\nM = \"c\"\n"
+        "do L < M {\n    if L == 50 {\n        L = L + 40\n    }\n    L = L + 1\n}\n"
+        "S | R | L";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    Value expected;
+    Interpreter tokenInterpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, InterpreterEngineTokens);
+    assert(tokenInterpreter.execute(exec, functions, expected));
+    Value result;
+    Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, InterpreterEngineBytecode);
+    assert(interpreter.execute(exec, functions, result));
+    assert(result.type() == expected.type());
+    assert(result == expected);
+}
+
+void testInterpreter22()
+{
+    // memoized functions give the results they give when they run, functions that read variables aren't memoized
+    std::string source =
+        "f ISPRIME {\n    ( a % (a - 2 i + 1) #* ) + (a == 2)\n}\n"
+        "f SCALED {\n    a * FACTOR\n}\n"
+        "f PAIR {\n    a | b | (a ISPRIME)\n}\n"
+        "FACTOR = 2\n"
+        "R = 40 i % 8 + 2 \\ ISPRIME\n"
+        "R = R | (3 SCALED) | (5 PAIR 6) | (5 PAIR 7) | (5 PAIR 6) | (\"abc\" PAIR 1)\n"
+        "FACTOR = 5\n"
+        "R | (3 SCALED)";
+    std::vector<Token> tokens;
+    std::unordered_map<std::string, Function> functions;
+    assert(Scanner::scan(source, tokens, functions, &errorPrinter));
+    std::vector<const Token*> exec;
+    assert(FunctionExtractor::extractFunctions(tokens, exec));
+
+    Value expected;
+    Interpreter tokenInterpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, InterpreterEngineTokens);
+    assert(tokenInterpreter.execute(exec, functions, expected));
+
+    Interpreter::setMemoization(true);
+    for(const auto engine: {InterpreterEngineTokens, InterpreterEngineSyntaxTree, InterpreterEngineBytecode}){
+        Value result;
+        Interpreter interpreter((IRuntimeErrorReporter*)&errorPrinter, (IInterpreterIO*)&io, engine);
+        assert(interpreter.execute(exec, functions, result));
+        assert(result.type() == expected.type());
+        assert(result == expected);
+
+        // 8 distinct numbers among 40, PAIR finds the result of 5 twice and adds the one of "abc"
+        const auto& statistics = interpreter.getMemoStatistics();
+        assert(statistics.count("SCALED") == 0);
+        assert(statistics.at("ISPRIME").misses == 9);
+        assert(statistics.at("ISPRIME").hits == 32 + 2);
+        assert(statistics.at("PAIR").misses == 3);
+        assert(statistics.at("PAIR").hits == 1);
+    }
+    Interpreter::setMemoization(false);
+}
 
 int main(){
     testLiteralParser();
+    testValue();
+    testCalculatorDestination();
+    testBroadcast();
+    testReductions();
+    testSort();
+    testSetOperators();
+    testRange();
+    testTypedValue();
+    testShardedLock();
+    testThreadPool();
     testStringUtil();
+    testJumpTargets();
+    testCompiler();
+    testOptimizer();
     testScanner1();
     testScanner2();
     testInterpreter1();
@@ -465,6 +1445,14 @@ int main(){
     testInterpreter12();
     testInterpreter13();
     testInterpreter14();
+    testInterpreter15();
+    testInterpreter16();
+    testInterpreter17();
+    testInterpreter18();
+    testInterpreter19();
+    testInterpreter20();
+    testInterpreter21();
+    testInterpreter22();
 
     std::cout << "ALL TESTS PASSED!" << std::endl;
     return 0;
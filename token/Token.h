@@ -1,12 +1,23 @@
 #pragma once
 #include "TokenId.h"
+#include "Value.h"
 #include <string>
-#include <vector>
 
-typedef std::vector<double> Value;
+struct Function;
 
 struct Token{
     std::string str;
     Value val;
     TokenId id;
+    // offset to the position this token jumps to (matching bracket, '{' of if/do, statement or async end)
+    // set by TokenSubArrayFinder::computeJumps
+    int jump = JUMP_NOT_COMPUTED;
+    // called function of a function token, set by Scanner::bindFunctions
+    const Function* function = nullptr;
+    // index of the variable of a variable token in ProgramState::variables, set by Scanner::bindVariables
+    int slot = SLOT_NOT_BOUND;
+
+    static const int JUMP_NOT_COMPUTED = -1;
+    static const int JUMP_NOT_FOUND = -2;
+    static const int SLOT_NOT_BOUND = -1;
 };
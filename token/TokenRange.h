@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "Token.h"
+
+// non owning view of consecutive tokens in a shared token array
+class TokenRange{
+public:
+    TokenRange(): tokens(nullptr), count(0){}
+
+    TokenRange(const Token* const* tokens, int count): tokens(tokens), count(count){}
+
+    TokenRange(const std::vector<const Token*>& tokens): tokens(tokens.data()), count(tokens.size()){}
+
+    int size() const { return count; }
+
+    const Token* operator[](int position) const { return tokens[position]; }
+
+    const Token* const* begin() const { return tokens; }
+
+    const Token* const* end() const { return tokens + count; }
+
+    // inclusive indexes, empty if end < start
+    TokenRange subRange(int start, int end) const
+    {
+        return end < start ? TokenRange(tokens + start, 0) : TokenRange(tokens + start, end - start + 1);
+    }
+
+private:
+    const Token* const* tokens;
+    int count;
+};
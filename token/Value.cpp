@@ -0,0 +1,281 @@
+#include "Value.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+Value::Value(std::initializer_list<double> numbers): buffer(nullptr), inlineSize(0), range(false)
+{
+    reserve(numbers.size());
+    for(const auto& i: numbers)
+        push_back(i);
+}
+
+Value::Value(const std::vector<double>& numbers): buffer(nullptr), inlineSize(0), range(false)
+{
+    reserve(numbers.size());
+    for(const auto& i: numbers)
+        push_back(i);
+}
+
+Value Value::makeRange(double start, double step, size_t size)
+{
+    Value value;
+    if(size == 0)
+        return value;
+
+    value.range = true;
+    value.inlineSize = size;
+    value.inlineNumbers[0] = start;
+    value.inlineNumbers[1] = step;
+    return value;
+}
+
+Value Value::makeCharacters(const char* characters, size_t size)
+{
+    if(size <= INLINE_CAPACITY){
+        Value value;
+        for(size_t i=0; i<size; i++)
+            value.push_back((double)characters[i]);
+        return value;
+    }
+
+    Value value = makeBytes(ValueTypeCharacter, size);
+    std::memcpy(value.buffer->bytes(), characters, size);
+    return value;
+}
+
+Value Value::makeBytes(ValueType type, size_t size)
+{
+    Value value;
+    if(size == 0)
+        return value;
+
+    value.buffer = allocate(size, type);
+    value.buffer->size = size;
+    return value;
+}
+
+Value& Value::operator=(const Value& other)
+{
+    if(this == &other)
+        return *this;
+
+    if(other.buffer != nullptr)
+        other.buffer->references.fetch_add(1, std::memory_order_relaxed);
+    release();
+    buffer = other.buffer;
+    inlineSize = other.inlineSize;
+    range = other.range;
+    if(buffer == nullptr)
+        copyInline(other);
+    return *this;
+}
+
+Value& Value::operator=(Value&& other) noexcept
+{
+    if(this == &other)
+        return *this;
+
+    release();
+    buffer = other.buffer;
+    inlineSize = other.inlineSize;
+    range = other.range;
+    if(buffer == nullptr)
+        copyInline(other);
+    other.buffer = nullptr;
+    other.inlineSize = 0;
+    other.range = false;
+    return *this;
+}
+
+double* Value::mutableData()
+{
+    if(range)
+        materialize();
+    if(buffer != nullptr && buffer->type != ValueTypeNumber)
+        widen();
+    if(buffer == nullptr)
+        return inlineNumbers;
+
+    if(buffer->references.load(std::memory_order_acquire) != 1)
+        detach(buffer->size);
+    return buffer->numbers();
+}
+
+unsigned char* Value::mutableBytes()
+{
+    if(buffer->references.load(std::memory_order_acquire) != 1){
+        Buffer* copy = allocate(buffer->capacity, buffer->type);
+        copy->size = buffer->size;
+        std::memcpy(copy->bytes(), buffer->bytes(), buffer->size);
+        unreference(buffer);
+        buffer = copy;
+    }
+    return buffer->bytes();
+}
+
+void Value::reserve(size_t capacity)
+{
+    if(range)
+        materialize();
+    if(buffer != nullptr && buffer->type != ValueTypeNumber)
+        widen();
+    if(buffer == nullptr){
+        if(capacity > INLINE_CAPACITY)
+            detach(capacity);
+        return;
+    }
+
+    if(capacity > buffer->capacity || buffer->references.load(std::memory_order_acquire) != 1)
+        detach(capacity);
+}
+
+void Value::resize(size_t size, double number)
+{
+    const size_t previousSize = this->size();
+    if(size == previousSize)
+        return;
+
+    if(range && size < previousSize){
+        *this = makeRange(rangeStart(), rangeStep(), size);
+        return;
+    }
+
+    // unshared bytes that shrink stay bytes
+    if(buffer != nullptr && buffer->type != ValueTypeNumber && size < previousSize && buffer->references.load(std::memory_order_acquire) == 1){
+        buffer->size = size;
+        return;
+    }
+
+    if(buffer != nullptr && buffer->type != ValueTypeNumber)
+        widen();
+
+    // a shared buffer that shrinks is copied only up to the new size
+    if(buffer != nullptr && size < previousSize && buffer->references.load(std::memory_order_acquire) != 1){
+        Value shrunk;
+        shrunk.reserve(size);
+        for(size_t i=0; i<size; i++)
+            shrunk.push_back(buffer->numbers()[i]);
+        *this = std::move(shrunk);
+        return;
+    }
+
+    reserve(size);
+    double* numbers = mutableData();
+    for(size_t i=previousSize; i<size; i++)
+        numbers[i] = number;
+    if(buffer == nullptr)
+        inlineSize = size;
+    else
+        buffer->size = size;
+}
+
+void Value::clear()
+{
+    // a shared buffer stays with the other values, an unshared one is kept for reuse
+    if(buffer != nullptr && buffer->type == ValueTypeNumber && buffer->references.load(std::memory_order_acquire) == 1)
+        buffer->size = 0;
+    else
+        release();
+}
+
+bool Value::operator==(const Value& other) const
+{
+    return size() == other.size() && std::equal(begin(), end(), other.begin());
+}
+
+void Value::detach(size_t capacity)
+{
+    if(buffer != nullptr && buffer->type != ValueTypeNumber)
+        widen();
+
+    const size_t size = this->size();
+    capacity = std::max(capacity, std::max(size, INLINE_CAPACITY + 1));
+
+    if(buffer != nullptr && buffer->references.load(std::memory_order_acquire) == 1){
+        if(capacity <= buffer->capacity)
+            return;
+
+        Buffer* grown = static_cast<Buffer*>(std::realloc(buffer, sizeof(Buffer) + capacity * sizeof(double)));
+        if(grown == nullptr)
+            throw std::bad_alloc();
+        grown->capacity = capacity;
+        buffer = grown;
+        return;
+    }
+
+    Buffer* copy = allocate(capacity);
+    copy->size = size;
+    if(size != 0)
+        std::memcpy(copy->numbers(), data(), size * sizeof(double));
+
+    release();
+    buffer = copy;
+}
+
+void Value::materialize() const
+{
+    const double start = rangeStart();
+    const double step = rangeStep();
+    const size_t size = inlineSize;
+    range = false;
+
+    double* numbers = inlineNumbers;
+    if(size > INLINE_CAPACITY){
+        buffer = allocate(size);
+        buffer->size = size;
+        inlineSize = 0;
+        numbers = buffer->numbers();
+    }
+    for(size_t i=0; i<size; i++)
+        numbers[i] = start + i * step;
+}
+
+void Value::widen() const
+{
+    Buffer* bytes = buffer;
+    const size_t size = bytes->size;
+    double* numbers = inlineNumbers;
+    buffer = nullptr;
+    inlineSize = size;
+    if(size > INLINE_CAPACITY){
+        buffer = allocate(size);
+        buffer->size = size;
+        inlineSize = 0;
+        numbers = buffer->numbers();
+    }
+    for(size_t i=0; i<size; i++)
+        numbers[i] = byteToNumber(bytes->type, bytes->bytes()[i]);
+    unreference(bytes);
+}
+
+Value::Buffer* Value::allocate(size_t capacity, ValueType type)
+{
+    const size_t elementSize = type == ValueTypeNumber ? sizeof(double) : sizeof(unsigned char);
+    Buffer* buffer = static_cast<Buffer*>(std::malloc(sizeof(Buffer) + capacity * elementSize));
+    if(buffer == nullptr)
+        throw std::bad_alloc();
+    new (&buffer->references) std::atomic<int>(1);
+    buffer->type = type;
+    buffer->size = 0;
+    buffer->capacity = capacity;
+    return buffer;
+}
+
+void Value::unreference(Buffer* buffer)
+{
+    if(buffer->references.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        buffer->references.~atomic();
+        std::free(buffer);
+    }
+}
+
+void Value::release()
+{
+    if(buffer != nullptr)
+        unreference(buffer);
+    buffer = nullptr;
+    inlineSize = 0;
+    range = false;
+}
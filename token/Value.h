@@ -0,0 +1,184 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+// element type of the storage of a value, characters and booleans take one byte per element
+enum ValueType{
+    ValueTypeNumber,
+    ValueTypeCharacter,
+    ValueTypeBoolean
+};
+
+// array of numbers, small arrays are stored inline and larger ones in shared, reference counted storage
+// copies share the storage, it is copied by the first mutation of a shared value
+// an arithmetic range only stores its start and step until its numbers are accessed
+// large text and boolean arrays are stored as bytes until their numbers are accessed as doubles
+class Value{
+public:
+    // arrays up to this size don't allocate
+    static const size_t INLINE_CAPACITY = 2;
+
+    Value(): buffer(nullptr), inlineSize(0), range(false){}
+
+    // start, start + step, ... with size numbers
+    static Value makeRange(double start, double step, size_t size);
+
+    // one character per element, arrays larger than the inline capacity are stored as bytes
+    static Value makeCharacters(const char* characters, size_t size);
+
+    // byte storage of size uninitialized characters or booleans
+    static Value makeBytes(ValueType type, size_t size);
+
+    Value(std::initializer_list<double> numbers);
+
+    explicit Value(const std::vector<double>& numbers);
+
+    Value(const Value& other): buffer(other.buffer), inlineSize(other.inlineSize), range(other.range)
+    {
+        if(buffer != nullptr)
+            buffer->references.fetch_add(1, std::memory_order_relaxed);
+        else
+            copyInline(other);
+    }
+
+    Value(Value&& other) noexcept : buffer(other.buffer), inlineSize(other.inlineSize), range(other.range)
+    {
+        if(buffer == nullptr)
+            copyInline(other);
+        other.buffer = nullptr;
+        other.inlineSize = 0;
+        other.range = false;
+    }
+
+    ~Value(){ release(); }
+
+    Value& operator=(const Value& other);
+
+    Value& operator=(Value&& other) noexcept;
+
+    size_t size() const { return buffer == nullptr ? inlineSize : buffer->size; }
+
+    bool empty() const { return size() == 0; }
+
+    // numbers of a range are calculated without storing them, bytes are read without widening them
+    double operator[](size_t position) const
+    {
+        if(range)
+            return inlineNumbers[0] + position * inlineNumbers[1];
+        if(buffer == nullptr)
+            return inlineNumbers[position];
+        return buffer->type == ValueTypeNumber ? buffer->numbers()[position] : byteToNumber(buffer->type, buffer->bytes()[position]);
+    }
+
+    // stores the numbers of a range and widens bytes to numbers
+    const double* data() const
+    {
+        if(range)
+            materialize();
+        if(buffer == nullptr)
+            return inlineNumbers;
+        if(buffer->type != ValueTypeNumber)
+            widen();
+        return buffer == nullptr ? inlineNumbers : buffer->numbers();
+    }
+
+    const double* begin() const { return data(); }
+
+    const double* end() const { return data() + size(); }
+
+    double back() const { return (*this)[size() - 1]; }
+
+    bool isRange() const { return range; }
+
+    double rangeStart() const { return inlineNumbers[0]; }
+
+    double rangeStep() const { return inlineNumbers[1]; }
+
+    ValueType type() const { return buffer == nullptr ? ValueTypeNumber : buffer->type; }
+
+    // storage of a character or boolean value
+    const unsigned char* bytes() const { return buffer->bytes(); }
+
+    unsigned char* mutableBytes();
+
+    // a character is stored as a char, a boolean as 0 or 1
+    static double byteToNumber(ValueType type, unsigned char byte)
+    {
+        return type == ValueTypeCharacter ? (double)(char)byte : (double)byte;
+    }
+
+    // mutations copy shared storage first
+    double* mutableData();
+
+    void push_back(double number)
+    {
+        if(range)
+            materialize();
+        if(buffer == nullptr && inlineSize < INLINE_CAPACITY){
+            inlineNumbers[inlineSize++] = number;
+            return;
+        }
+        if(buffer == nullptr || buffer->size == buffer->capacity || buffer->type != ValueTypeNumber ||
+            buffer->references.load(std::memory_order_acquire) != 1)
+            detach(2 * size());
+        buffer->numbers()[buffer->size++] = number;
+    }
+
+    void reserve(size_t capacity);
+
+    void resize(size_t size, double number = 0.0);
+
+    void clear();
+
+    bool operator==(const Value& other) const;
+
+    bool operator!=(const Value& other) const { return !(*this == other); }
+
+private:
+    struct Buffer{
+        std::atomic<int> references;
+        ValueType type;
+        size_t size;
+        size_t capacity;
+
+        // the elements follow the header in the same allocation
+        double* numbers() { return reinterpret_cast<double*>(this + 1); }
+        const double* numbers() const { return reinterpret_cast<const double*>(this + 1); }
+        unsigned char* bytes() { return reinterpret_cast<unsigned char*>(this + 1); }
+        const unsigned char* bytes() const { return reinterpret_cast<const unsigned char*>(this + 1); }
+    };
+
+    void copyInline(const Value& other)
+    {
+        const size_t size = range ? 2 : inlineSize;
+        for(size_t i=0; i<size; i++)
+            inlineNumbers[i] = other.inlineNumbers[i];
+    }
+
+    void materialize() const;
+
+    // replaces byte storage with numbers, up to INLINE_CAPACITY of them are stored inline and buffer becomes null
+    void widen() const;
+
+    static Buffer* allocate(size_t capacity, ValueType type = ValueTypeNumber);
+
+    static void unreference(Buffer* buffer);
+
+    // moves the numbers to unique storage with room for at least capacity numbers
+    void detach(size_t capacity);
+
+    // leaves an empty inline value
+    void release();
+
+    // a range is materialized and bytes are widened by const accessors
+    mutable Buffer* buffer;
+    // number of inline numbers or size of the range
+    mutable size_t inlineSize;
+    // the start and step of the range are the inline numbers
+    mutable bool range;
+    mutable double inlineNumbers[INLINE_CAPACITY];
+
+    static_assert(INLINE_CAPACITY >= 2, "a range is stored in the inline numbers");
+};
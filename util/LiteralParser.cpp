@@ -57,24 +57,25 @@ bool LiteralParser::parseString(const std::string& literal, Value& value)
     if(literal[size] != '"' || size < 2 || literal[0] != '"')
         return false;
 
+    std::string characters;
     for(int i=1; i<size; i++){
         if(literal[i]!='\\'){
-            value.push_back((double)literal[i]);
+            characters.push_back(literal[i]);
         }else if(i+1<size){
             i++;
             switch (literal[i])
             {
             case 'n':
-                value.push_back((double)'\n');
+                characters.push_back('\n');
                 break;
             case 't':
-                value.push_back((double)'\t');
+                characters.push_back('\t');
                 break;
             case '0':
-                value.push_back((double)'\0');
+                characters.push_back('\0');
                 break;
             default:
-                value.push_back((double)literal[i]);
+                characters.push_back(literal[i]);
                 break;
             }
         }else{
@@ -82,5 +83,7 @@ bool LiteralParser::parseString(const std::string& literal, Value& value)
         }
     }
 
+    // text is stored as bytes
+    value = Value::makeCharacters(characters.data(), characters.size());
     return true;
 }
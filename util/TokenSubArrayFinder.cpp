@@ -7,14 +7,7 @@ void TokenSubArrayFinder::findSubArray(const std::vector<Token>& src, std::vecto
     }
 }
 
-void TokenSubArrayFinder::findSubArray(const std::vector<const Token*>& src, std::vector<const Token*>& dest, int start, int end)
-{
-    for(int i=start; i<=end; i++){
-        dest.push_back(src[i]);
-    }
-}
-
-int TokenSubArrayFinder::findClosingCurly(const std::vector<const Token*> &tokens, int currentPosition)
+int TokenSubArrayFinder::findClosingCurly(const TokenRange& tokens, int currentPosition)
 {
     const int size = tokens.size();
     int open = 1;
@@ -31,7 +24,7 @@ int TokenSubArrayFinder::findClosingCurly(const std::vector<const Token*> &token
     return TOKEN_INDEX_NOT_FOUND;
 }
 
-int TokenSubArrayFinder::findClosingParenthesis(const std::vector<const Token*> &tokens, int currentPosition)
+int TokenSubArrayFinder::findClosingParenthesis(const TokenRange& tokens, int currentPosition)
 {
     const int size = tokens.size();
     int open = 1;
@@ -66,7 +59,7 @@ int TokenSubArrayFinder::findClosingCurly(const std::vector<Token> &tokens, int
     return TOKEN_INDEX_NOT_FOUND;
 }
 
-int TokenSubArrayFinder::findStatementEnd(const std::vector<const Token*> &tokens, int currentPosition)
+int TokenSubArrayFinder::findStatementEnd(const TokenRange& tokens, int currentPosition)
 {
     const int size = tokens.size();
     for(; currentPosition < size; currentPosition++){
@@ -77,7 +70,7 @@ int TokenSubArrayFinder::findStatementEnd(const std::vector<const Token*> &token
     return size-1;
 }
 
-int TokenSubArrayFinder::findFirstTokenIdInLine(const std::vector<const Token*> &tokens, int currentPosition, TokenId id)
+int TokenSubArrayFinder::findFirstTokenIdInLine(const TokenRange& tokens, int currentPosition, TokenId id)
 {
     const int size = tokens.size();
     for(bool seenEndLine = false; currentPosition<size; currentPosition++){
@@ -92,7 +85,7 @@ int TokenSubArrayFinder::findFirstTokenIdInLine(const std::vector<const Token*>
     return TOKEN_INDEX_NOT_FOUND;
 }
 
-int TokenSubArrayFinder::findFirstTokenId(const std::vector<const Token*> &tokens, int currentPosition, TokenId id)
+int TokenSubArrayFinder::findFirstTokenId(const TokenRange& tokens, int currentPosition, TokenId id)
 {
     for(const int size = tokens.size(); currentPosition<size; currentPosition++){
         if(tokens[currentPosition]->id == id)
@@ -102,3 +95,76 @@ int TokenSubArrayFinder::findFirstTokenId(const std::vector<const Token*> &token
     return TOKEN_INDEX_NOT_FOUND;
 }
 
+int TokenSubArrayFinder::findJumpTarget(const TokenRange& tokens, int currentPosition)
+{
+    const int jump = tokens[currentPosition]->jump;
+    if(jump == Token::JUMP_NOT_COMPUTED)
+        return scanJumpTarget(tokens, currentPosition);
+    
+    if(jump == Token::JUMP_NOT_FOUND)
+        return TOKEN_INDEX_NOT_FOUND;
+
+    const int size = tokens.size();
+    if(currentPosition + jump < size)
+        return currentPosition + jump;
+    
+    // target is outside of the sub array (the jumps were computed for the full array)
+    switch(tokens[currentPosition]->id)
+    {
+    case TokenIdEquals:
+    case TokenIdWrite:
+    case TokenIdWriteText:
+        return size-1;
+    default:
+        return TOKEN_INDEX_NOT_FOUND;
+    }
+}
+
+void TokenSubArrayFinder::computeJumps(const TokenRange& tokens, std::vector<int>& jumps)
+{
+    const int size = tokens.size();
+    jumps.resize(size);
+    for(int i=0; i<size; i++){
+        switch(tokens[i]->id)
+        {
+        case TokenIdOpenParenthesis:
+        case TokenIdOpenCurly:
+        case TokenIdIf:
+        case TokenIdLoop:
+        case TokenIdAsyncStart:
+        case TokenIdEquals:
+        case TokenIdWrite:
+        case TokenIdWriteText:
+        {
+            const int target = scanJumpTarget(tokens, i);
+            jumps[i] = target == TOKEN_INDEX_NOT_FOUND ? Token::JUMP_NOT_FOUND : target - i;
+        }
+        break;
+        default:
+            jumps[i] = Token::JUMP_NOT_COMPUTED;
+        break;
+        }
+    }
+}
+
+int TokenSubArrayFinder::scanJumpTarget(const TokenRange& tokens, int currentPosition)
+{
+    switch(tokens[currentPosition]->id)
+    {
+    case TokenIdOpenParenthesis:
+        return findClosingParenthesis(tokens, currentPosition);
+    case TokenIdOpenCurly:
+        return findClosingCurly(tokens, currentPosition);
+    case TokenIdIf:
+    case TokenIdLoop:
+        return findFirstTokenIdInLine(tokens, currentPosition, TokenIdOpenCurly);
+    case TokenIdAsyncStart:
+        return findFirstTokenId(tokens, currentPosition, TokenIdAsyncEnd);
+    case TokenIdEquals:
+    case TokenIdWrite:
+    case TokenIdWriteText:
+        return findStatementEnd(tokens, currentPosition);
+    default:
+        return TOKEN_INDEX_NOT_FOUND;
+    }
+}
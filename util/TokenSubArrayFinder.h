@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include "../token/Token.h"
+#include "../token/TokenRange.h"
 
 class TokenSubArrayFinder{
 public:
@@ -8,21 +9,30 @@ public:
     //doesn't clear dest
     static void findSubArray(const std::vector<Token>& src, std::vector<const Token*>& dest, int start, int end);
 
-    static void findSubArray(const std::vector<const Token*>& src, std::vector<const Token*>& dest, int start, int end);
-
     //return new position(moves forwards) (currentPosition token is ignored)
-    static int findClosingCurly(const std::vector<const Token*> &tokens, int currentPosition);
+    static int findClosingCurly(const TokenRange& tokens, int currentPosition);
 
     static int findClosingCurly(const std::vector<Token> &tokens, int currentPosition);
 
-    static int findClosingParenthesis(const std::vector<const Token*> &tokens, int currentPosition);
+    static int findClosingParenthesis(const TokenRange& tokens, int currentPosition);
 
-    static int findStatementEnd(const std::vector<const Token*> &tokens, int currentPosition);
+    static int findStatementEnd(const TokenRange& tokens, int currentPosition);
 
     //return the index of the first token that matches the id in the current line (empty lines following are currentPosition are ignored) (moves forwards)
-    static int findFirstTokenIdInLine(const std::vector<const Token*> &tokens, int currentPosition, TokenId id);
+    static int findFirstTokenIdInLine(const TokenRange& tokens, int currentPosition, TokenId id);
+
+    static int findFirstTokenId(const TokenRange& tokens, int currentPosition, TokenId id);
 
-    static int findFirstTokenId(const std::vector<const Token*> &tokens, int currentPosition, TokenId id);
+    //return the position the token at currentPosition jumps to:
+    //'(' and '{' -> matching closing bracket, "if" and "do" -> opening '{', '[' -> ']', '=', 'w' and 't' -> statement end
+    //uses the offsets set by computeJumps, tokens are scanned if the offsets were not computed
+    static int findJumpTarget(const TokenRange& tokens, int currentPosition);
+
+    //one time layout pass, jumps[i] is the offset for tokens[i] (to be stored in Token::jump)
+    static void computeJumps(const TokenRange& tokens, std::vector<int>& jumps);
 
     static const int TOKEN_INDEX_NOT_FOUND = -1;
+
+private:
+    static int scanJumpTarget(const TokenRange& tokens, int currentPosition);
 };